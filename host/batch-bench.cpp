@@ -0,0 +1,164 @@
+// Host check for the batched publish payloads.
+//
+// Logs a synthetic day of readings (one every 15 minutes), uploads them the
+// way the firmware does, in batches of UPLOAD_EVERY_CYCLES readings, and
+// compares the payload bytes per reading and publishes per day against one
+// JSON object per reading. Every payload is decoded again: the JSON batches
+// must give back the exact records, the bit-packed frames (plain, and
+// delta compressed from version 2 on) the records at the precision of the
+// frame. Build and run with `npm run bench:batch`.
+
+#include "batch-packer.h"
+#include "telemetry-frame.h"
+#include "synthetic-day.h"
+#include "telemetry-json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UPLOAD_EVERY_CYCLES 4
+
+typedef int (*PackFunction)(const TelemetryRecord* records, int count, char* buffer, size_t limit);
+typedef int (*DecodeFunction)(const char* payload, TelemetryRecord* records, int max);
+typedef bool (*CompareFunction)(const TelemetryRecord& decoded, const TelemetryRecord& logged);
+
+static bool sameRecord(const TelemetryRecord& a, const TelemetryRecord& b) {
+    TelemetryRecord x = a;
+    TelemetryRecord y = b;
+    x.crc = y.crc = 0;
+    x.reserved = y.reserved = 0;
+    return memcmp(&x, &y, sizeof(TelemetryRecord)) == 0;
+}
+
+static int packFrameVersion1(const TelemetryRecord* records, int count, char* buffer, size_t limit) {
+    return TelemetryFrame::pack(records, count, buffer, limit, 1);
+}
+
+static int packFrameVersion2(const TelemetryRecord* records, int count, char* buffer, size_t limit) {
+    return TelemetryFrame::pack(records, count, buffer, limit, 2);
+}
+
+static int packFrameVersion3(const TelemetryRecord* records, int count, char* buffer, size_t limit) {
+    return TelemetryFrame::pack(records, count, buffer, limit, 3);
+}
+
+static int packFrameVersion4(const TelemetryRecord* records, int count, char* buffer, size_t limit) {
+    return TelemetryFrame::pack(records, count, buffer, limit, 4);
+}
+
+static bool within(long decoded, long logged, long tolerance) {
+    return labs(decoded - logged) <= tolerance;
+}
+
+// every frame version keeps whole % humidity, hundredths of inHg, vane
+// sectors and 10 mV steps, everything else is exact. The interval decision
+// is only there from version 3, the power governor's from version 4.
+static bool sameAtFramePrecision(const TelemetryRecord& d, const TelemetryRecord& r) {
+    long direction = labs((long)d.windDegrees - r.windDegrees);
+    if (direction > 1800) direction = 3600 - direction;
+
+    bool same = d.sequence == r.sequence && d.timestamp == r.timestamp
+        && d.tempF == r.tempF && within(d.humidity, r.humidity, 5)
+        && within(d.pressure, r.pressure, 5) && d.pressureTendency == r.pressureTendency
+        && d.soilTempF == r.soilTempF && d.soilProbeCount == r.soilProbeCount
+        && d.soilMoisture == r.soilMoisture && d.windMPH == r.windMPH && d.gustMPH == r.gustMPH
+        && direction <= 113 && d.rainTips == r.rainTips && d.rainHourTips == r.rainHourTips
+        && d.rainDayTips == r.rainDayTips && d.rainPeakIntensity == r.rainPeakIntensity
+        && within(d.vcell, r.vcell, 5) && d.soc == r.soc;
+    for (int probe = 0; same && probe < r.soilProbeCount; probe++) {
+        same = d.soilProbeTempsF[probe] == r.soilProbeTempsF[probe];
+    }
+    return same;
+}
+
+static bool sameAtFrameVersion3Precision(const TelemetryRecord& d, const TelemetryRecord& r) {
+    return sameAtFramePrecision(d, r) && d.interval == r.interval && d.intervalReason == r.intervalReason;
+}
+
+static bool sameAtFrameVersion4Precision(const TelemetryRecord& d, const TelemetryRecord& r) {
+    return sameAtFrameVersion3Precision(d, r) && d.hoursToEmpty == r.hoursToEmpty && d.powerTier == r.powerTier;
+}
+
+// Uploads the day in chunks of `chunk` readings, returns false on a
+// round-trip mismatch.
+static bool upload(const TelemetryRecord* records, int count, int chunk, PackFunction pack, DecodeFunction decode,
+        CompareFunction compare, int* publishes, long* bytes, int* largest) {
+    char payload[BATCH_EVENT_LIMIT];
+    TelemetryRecord decoded[64];
+
+    *publishes = 0;
+    *bytes = 0;
+    *largest = 0;
+    for (int start = 0; start < count; start += chunk) {
+        int end = start + chunk < count ? start + chunk : count;
+        int next = start;
+        while (next < end) {
+            int packed = pack(records + next, end - next, payload, sizeof(payload));
+            if (packed == 0) {
+                printf("record %d doesn't fit in an event\n", next);
+                return false;
+            }
+
+            int n = decode(payload, decoded, 64);
+            if (n != packed) {
+                printf("decoded %d of %d records: %s\n", n, packed, payload);
+                return false;
+            }
+            for (int i = 0; i < n; i++) {
+                if (!compare(decoded[i], records[next + i])) {
+                    printf("record %u doesn't round-trip: %s\n", records[next + i].sequence, payload);
+                    return false;
+                }
+            }
+
+            (*publishes)++;
+            *bytes += strlen(payload);
+            if (packed > *largest) *largest = packed;
+            next += packed;
+        }
+    }
+    return true;
+}
+
+static bool report(const char* name, const TelemetryRecord* records, int chunk, PackFunction pack, DecodeFunction decode, CompareFunction compare) {
+    int publishes, largest;
+    long bytes;
+
+    if (!upload(records, READINGS_PER_DAY, chunk, pack, decode, compare, &publishes, &bytes, &largest)) {
+        return false;
+    }
+    printf("%-32s %10d %14.1f %16d\n", name, publishes, (double)bytes / READINGS_PER_DAY, largest);
+    return true;
+}
+
+int main() {
+    TelemetryRecord records[READINGS_PER_DAY];
+    char json[400];
+    long singleBytes = 0;
+    for (int i = 0; i < READINGS_PER_DAY; i++) {
+        records[i] = makeRecord(i);
+        singleBytes += formatRecordJson(records[i], json, sizeof(json));
+    }
+
+    printf("%d readings, %d byte event limit\n\n", READINGS_PER_DAY, BATCH_EVENT_LIMIT);
+    printf("%-32s %10s %14s %16s\n", "", "publishes", "bytes/reading", "readings/event");
+    printf("%-32s %10d %14.1f %16d\n", "one JSON object per reading", READINGS_PER_DAY, (double)singleBytes / READINGS_PER_DAY, 1);
+
+    bool ok = report("JSON batch every 4 cycles", records, UPLOAD_EVERY_CYCLES, BatchPacker::pack, BatchDecoder::decode, sameRecord)
+        && report("JSON batch, whole day backlog", records, READINGS_PER_DAY, BatchPacker::pack, BatchDecoder::decode, sameRecord)
+        && report("frame v1 every 4 cycles", records, UPLOAD_EVERY_CYCLES, packFrameVersion1, TelemetryFrame::decode, sameAtFramePrecision)
+        && report("frame v1, whole day backlog", records, READINGS_PER_DAY, packFrameVersion1, TelemetryFrame::decode, sameAtFramePrecision)
+        && report("frame v2 every 4 cycles", records, UPLOAD_EVERY_CYCLES, packFrameVersion2, TelemetryFrame::decode, sameAtFramePrecision)
+        && report("frame v2, whole day backlog", records, READINGS_PER_DAY, packFrameVersion2, TelemetryFrame::decode, sameAtFramePrecision)
+        && report("frame v3 every 4 cycles", records, UPLOAD_EVERY_CYCLES, packFrameVersion3, TelemetryFrame::decode, sameAtFrameVersion3Precision)
+        && report("frame v3, whole day backlog", records, READINGS_PER_DAY, packFrameVersion3, TelemetryFrame::decode, sameAtFrameVersion3Precision)
+        && report("frame v4 every 4 cycles", records, UPLOAD_EVERY_CYCLES, packFrameVersion4, TelemetryFrame::decode, sameAtFrameVersion4Precision)
+        && report("frame v4, whole day backlog", records, READINGS_PER_DAY, packFrameVersion4, TelemetryFrame::decode, sameAtFrameVersion4Precision);
+    if (!ok) {
+        return 1;
+    }
+
+    printf("\nall payloads decode back to the logged records\n");
+    return 0;
+}
@@ -0,0 +1,318 @@
+// Host run of the whole acquisition cycle.
+//
+// Builds WeatherService against the Linux backend in host/hal and runs it
+// through a day of the same loop() passes as the device, runOnce() and
+// sleep(): read, log, upload once a batch is waiting, then sleep, with rain
+// gauge wakes in between. Time is virtual, so the day takes well under a
+// second, and the report shows the simulated awake time of every cycle next
+// to what the cycle cost the host CPU, the I2C transactions and bus time
+// each sensor model saw, and the time the soil probes held the 1-Wire bus.
+//
+// The weather changes through the day: a gusty wind that veers and picks
+// up as a front comes through, pressure falling ahead of it and rising
+// behind, a shower, and temperature and humidity following the sun. The
+// battery runs down into the saver tier. One humidity reading fails its
+// CRC, another times out, the barometer misses a reading, one probe drops
+// off the bus for two cycles and another sends a bad CRC, so the retries
+// and rescans that follow show in the report. Build and run with
+// `npm run bench:cycle`.
+//
+// With --trace the firmware runs in debug mode with trace lines on, its
+// serial output goes to stdout and the report to stderr, so
+// `npm run -s bench:cycle -- --trace > day.trace` records a trace of the
+// simulated station for host/trace-replay.cpp.
+
+#include "application.h"
+#include "weather-service.h"
+#include "si7021-model.h"
+#include "mpl3115a2-model.h"
+#include "one-wire-models.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+
+#define CYCLES 96
+#define ANEMOMETER_PIN D3
+#define RAIN_GAUGE_PIN D2
+#define SOIL_PROBE_PIN D4
+#define WIND_VANE_PIN A0
+#define SOIL_MOISTURE_PIN A1
+
+// the sensor fault schedule
+#define HUMIDITY_CRC_CYCLE 20
+#define PRESSURE_TIMEOUT_CYCLE 30
+#define DROPOUT_CYCLE 40
+#define DROPOUT_CYCLES 2
+#define CRC_FAULT_CYCLE 60
+#define HUMIDITY_TIMEOUT_CYCLE 75
+
+// the front comes through between these hours, the shower at its middle
+#define FRONT_START_HOURS 8.0
+#define FRONT_END_HOURS 16.0
+#define SHOWER_START_HOURS 11.0
+#define SHOWER_END_HOURS 13.0
+
+#define DAY_SECONDS (24 * 60 * 60.0)
+
+// a vane ADC value in the middle of each sector's range, north first
+static const int VANE_SECTOR_RAW[] = {
+    3635, 2650, 2800, 1545, 1615, 1490, 1950, 1725,
+    2300, 2150, 3250, 3150, 3945, 3740, 3835, 3450
+};
+
+static double hoursAt(uint64_t at) {
+    return fmod(at / 3600e6, 24.0);
+}
+
+// 0 outside the front, rising to 1 at its middle
+static double frontAt(uint64_t at) {
+    double hours = hoursAt(at);
+    if (hours < FRONT_START_HOURS || hours > FRONT_END_HOURS) {
+        return 0;
+    }
+    return sin(M_PI * (hours - FRONT_START_HOURS) / (FRONT_END_HOURS - FRONT_START_HOURS));
+}
+
+// a daily swing peaking mid afternoon, -1 to 1
+static double sunAt(uint64_t at) {
+    return sin(2 * M_PI * (at / 1e6 - 9 * 3600) / DAY_SECONDS);
+}
+
+// A wind of 3 to 8 MPH with the day, up to 18 MPH with the front, gusting
+// half as strong again for 3 seconds out of every 10.
+class GustyWind : public VirtualEventSource {
+    public:
+        GustyWind(int pin) {
+            _pin = pin;
+            _next = periodAt(0);
+        }
+
+        uint64_t nextEventAt() {
+            return _next;
+        }
+
+        void fire(uint64_t now) {
+            VirtualHal::pulse(_pin);
+            _next += periodAt(_next);
+        }
+    private:
+        static uint64_t periodAt(uint64_t at) {
+            double mph = 5.5 + 2.5 * sunAt(at) + 10 * frontAt(at);
+            if ((at / 1000000) % 10 < 3) {
+                mph *= 1.5;
+            }
+            // 1 Hz is 1.492 MPH
+            return (uint64_t)(1.492e6 / mph);
+        }
+
+        int _pin;
+        uint64_t _next;
+};
+
+// Rain gauge tips through the shower, a tip every 4 minutes at its edges
+// down to every 40 seconds at its peak.
+class Shower : public VirtualEventSource {
+    public:
+        Shower(int pin) {
+            _pin = pin;
+            _next = nextTipAfter(0);
+        }
+
+        uint64_t nextEventAt() {
+            return _next;
+        }
+
+        void fire(uint64_t now) {
+            VirtualHal::pulse(_pin);
+            _next = nextTipAfter(_next);
+        }
+    private:
+        static uint64_t nextTipAfter(uint64_t at) {
+            double hours = hoursAt(at);
+            if (hours < SHOWER_START_HOURS) {
+                return at + (uint64_t)((SHOWER_START_HOURS - hours) * 3600e6);
+            }
+            if (hours >= SHOWER_END_HOURS) {
+                return at + (uint64_t)((24 - hours + SHOWER_START_HOURS) * 3600e6);
+            }
+            double peak = sin(M_PI * (hours - SHOWER_START_HOURS) / (SHOWER_END_HOURS - SHOWER_START_HOURS));
+            return at + (uint64_t)((240 - 200 * peak) * 1e6);
+        }
+
+        int _pin;
+        uint64_t _next;
+};
+
+// Pressure falls 6 hPa ahead of the front and recovers behind it.
+class FrontBarometer : public Mpl3115a2Model {
+    protected:
+        void getConditions(uint64_t at, float* pascals, float* celsius) {
+            double hours = hoursAt(at);
+            double dip = 0;
+            if (hours >= FRONT_START_HOURS - 4 && hours < 12) {
+                dip = (hours - (FRONT_START_HOURS - 4)) / (12 - (FRONT_START_HOURS - 4));
+            } else if (hours >= 12 && hours < FRONT_END_HOURS + 4) {
+                dip = 1 - (hours - 12) / (FRONT_END_HOURS + 4 - 12);
+            }
+            *pascals = 101325 - 600 * dip;
+            *celsius = 18 + 6 * sunAt(at);
+        }
+};
+
+// The vane swings a sector either side of where the wind is from, which
+// veers a sector every 90 minutes.
+static int swingVane(int pin, void* context) {
+    if (pin != WIND_VANE_PIN) {
+        return -1;
+    }
+    int* sample = (int*)context;
+    int sector = (int)(VirtualHal::clock().now() / 5400e6) + (*sample)++ % 3 - 1;
+    return VANE_SECTOR_RAW[(sector + 16) % 16];
+}
+
+// The soil profile the firmware reported, "-" when there was none.
+static const char* soilProfile(const char* json, char* out, size_t size) {
+    const char* start = strstr(json, "\"sp\":[");
+    const char* end = start ? strchr(start, ']') : NULL;
+    if (!end) {
+        snprintf(out, size, "-");
+    } else {
+        snprintf(out, size, "%.*s", (int)(end - start - 6), start + 6);
+    }
+    return out;
+}
+
+int main(int argc, char** argv) {
+    bool record = argc > 1 && strcmp(argv[1], "--trace") == 0;
+    FILE* report = record ? stderr : stdout;
+
+    VirtualHal::reset();
+    VirtualHal::setSerialEcho(record);
+    int vaneSample = 0;
+    VirtualHal::setAnalogHandler(swingVane, &vaneSample);
+
+    GustyWind wind(ANEMOMETER_PIN);
+    VirtualHal::clock().addSource(&wind);
+    Shower shower(RAIN_GAUGE_PIN);
+    VirtualHal::clock().addSource(&shower);
+
+    Si7021Model humidity(HUMIDITY_SI7021);
+    VirtualHal::attachI2c(&humidity);
+    FrontBarometer barometer;
+    VirtualHal::attachI2c(&barometer);
+    VirtualHal::clock().addSource(&barometer);
+
+    // one of each probe the firmware knows, cooler the deeper they are
+    Ds18x20Model shallow(FAMILY_DS18B20, 0x0000A1B2C3D4ULL);
+    shallow.setTemperature(16);
+    Ds18x20Model middle(FAMILY_DS1822, 0x000011223344ULL);
+    middle.setTemperature(14.5);
+    middle.setResolution(10);
+    Ds18x20Model deep(FAMILY_DS18S20, 0x0000557799BBULL);
+    deep.setTemperature(13.2);
+    Ds2438Model battery(0x000000C0FFEEULL);
+    battery.setTemperature(12.75);
+    OneWireModelBus soilBus;
+    soilBus.attach(&shallow);
+    soilBus.attach(&middle);
+    soilBus.attach(&deep);
+    soilBus.attach(&battery);
+    VirtualHal::attachOneWire(SOIL_PROBE_PIN, &soilBus);
+
+    WeatherService weatherService;
+    weatherService.init(record, record);
+    weatherService.setSleepBounds(MIN_SECONDS_TO_SLEEP, MINUTES_TO_SLEEP, MAX_SECONDS_TO_SLEEP);
+
+    fprintf(report, "init: Si7021 %lu transactions, MPL3115A2 %lu\n\n", humidity.getTransactionCount(), barometer.getTransactionCount());
+
+    fprintf(report, "cycle  awake (ms)  host (us)  payload bytes  Si7021 I2C (us)  MPL3115A2 I2C (us)  1-Wire slots (us)  soil profile\n");
+    uint64_t totalAwake = 0;
+    double totalHost = 0;
+    unsigned long totalTransactions = 0;
+    uint64_t totalBus = 0;
+    uint64_t totalOneWire = 0;
+    uint64_t scanOneWire = 0;
+    int scans = 0;
+    unsigned long rainWakes = 0;
+    bool skipped = false;
+    int cycle = 0;
+    while (cycle < CYCLES) {
+        // the conditions of the next cycle, wetter and cooler under the shower
+        uint64_t now = VirtualHal::clock().now();
+        double rain = hoursAt(now) >= SHOWER_START_HOURS && hoursAt(now) < SHOWER_END_HOURS + 2 ? 1 : 0;
+        humidity.setConditions(65 - 20 * sunAt(now) + 25 * rain, 18 + 6 * sunAt(now) - 4 * rain);
+        VirtualHal::setAnalog(SOIL_MOISTURE_PIN, 1500 + 900 * rain);
+        shallow.setTemperature(16 + 2 * sunAt(now));
+        VirtualHal::setFuelGauge(4.1 - cycle * 0.004, 90 - cycle * 0.45);
+
+        humidity.injectCrcFaults(cycle == HUMIDITY_CRC_CYCLE ? MEASUREMENT_RETRIES + 1 : 0);
+        humidity.setPresent(cycle != HUMIDITY_TIMEOUT_CYCLE);
+        barometer.setPresent(cycle != PRESSURE_TIMEOUT_CYCLE);
+        if (cycle == DROPOUT_CYCLE) {
+            middle.setPresent(false);
+        } else if (cycle == DROPOUT_CYCLE + DROPOUT_CYCLES) {
+            middle.setPresent(true);
+        } else if (cycle == CRC_FAULT_CYCLE) {
+            deep.injectCrcFaults(1);
+        }
+
+        uint64_t start = VirtualHal::clock().now();
+        humidity.resetCounters();
+        barometer.resetCounters();
+        soilBus.resetCounters();
+        unsigned long searches = shallow.getSearchCount();
+        auto hostStart = std::chrono::steady_clock::now();
+
+        // loop() as the device runs it, a pass without a cycle due only sleeps
+        LoopPass pass = weatherService.runOnce();
+        if (pass.cycleRan) {
+            double host = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - hostStart).count();
+            uint64_t awake = VirtualHal::clock().now() - start;
+            bool scanned = shallow.getSearchCount() != searches;
+            totalAwake += awake;
+            totalHost += host;
+            totalTransactions += humidity.getTransactionCount() + barometer.getTransactionCount();
+            totalBus += humidity.getBusMicros() + barometer.getBusMicros();
+            totalOneWire += soilBus.getBusMicros();
+            if (scanned) {
+                scans++;
+                scanOneWire += soilBus.getBusMicros();
+            }
+
+            bool faulted = cycle == HUMIDITY_CRC_CYCLE || cycle == HUMIDITY_TIMEOUT_CYCLE;
+            faulted |= cycle >= PRESSURE_TIMEOUT_CYCLE && cycle <= PRESSURE_TIMEOUT_CYCLE + 1;
+            faulted |= cycle >= DROPOUT_CYCLE && cycle <= DROPOUT_CYCLE + DROPOUT_CYCLES + 1;
+            faulted |= cycle >= CRC_FAULT_CYCLE && cycle <= CRC_FAULT_CYCLE + 1;
+            if (cycle < 4 || faulted || cycle == CYCLES - 1) {
+                char profile[48];
+                fprintf(report, "%5d  %10.1f  %9.0f  %13zu  %3lu %11llu  %3lu %14llu  %4lu %11llu%s  %s\n", cycle, awake / 1000.0, host, strlen(pass.reading),
+                    humidity.getTransactionCount(), (unsigned long long)humidity.getBusMicros(),
+                    barometer.getTransactionCount(), (unsigned long long)barometer.getBusMicros(),
+                    soilBus.getSlotCount(), (unsigned long long)soilBus.getBusMicros(), scanned ? "*" : " ",
+                    soilProfile(pass.reading, profile, sizeof(profile)));
+                skipped = false;
+            } else if (!skipped) {
+                fprintf(report, "  ...\n");
+                skipped = true;
+            }
+            cycle++;
+        }
+
+        // a tip wakes the station early, it logs the tip and sleeps on
+        if (cycle < CYCLES && weatherService.sleep(pass.sleepSeconds)) {
+            rainWakes++;
+        }
+    }
+
+    fprintf(report, "\n%d cycles over %.1f simulated hours\n", CYCLES, VirtualHal::clock().now() / 3600e6);
+    fprintf(report, "mean awake per cycle: %.1f ms simulated, %.0f us on the host\n", totalAwake / 1000.0 / CYCLES, totalHost / CYCLES);
+    fprintf(report, "mean I2C per cycle: %.1f transactions, %.0f us of bus time\n", (double)totalTransactions / CYCLES, (double)totalBus / CYCLES);
+    fprintf(report, "mean 1-Wire per cycle: %.0f us of bus time, %d cycles (*) searched the bus, %.0f us each\n",
+        (double)totalOneWire / CYCLES, scans, scans ? (double)scanOneWire / scans : 0.0);
+    fprintf(report, "probe conversions: DS18B20 %lu, DS1822 %lu, DS18S20 %lu, DS2438 %lu\n",
+        shallow.getConversionCount(), middle.getConversionCount(), deep.getConversionCount(), battery.getConversionCount());
+    fprintf(report, "rain gauge wakes: %lu, %lu tips logged\n", rainWakes, weatherService.getRainTips());
+    fprintf(report, "published %lu events, %lu bytes\n", VirtualHal::getPublishCount(), VirtualHal::getPublishBytes());
+    return 0;
+}
@@ -0,0 +1,49 @@
+// Decodes "wf" telemetry frames back into the single reading JSON payload,
+// one line per reading, for whatever consumed the old "w" events.
+//
+// Frames are read from the arguments, or one per line from stdin:
+//   npm run -s decode:frame -- AbCd...
+//   particle subscribe wf | ... | npm run -s decode:frame
+
+#include "telemetry-frame.h"
+#include "telemetry-json.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static int decodeFrame(const char* frame) {
+    TelemetryRecord records[TELEMETRY_FRAME_MAX_READINGS];
+    char json[400];
+
+    int count = TelemetryFrame::decode(frame, records, TELEMETRY_FRAME_MAX_READINGS);
+    if (count < 0) {
+        fprintf(stderr, "not a telemetry frame: %s\n", frame);
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        formatRecordJson(records[i], json, sizeof(json));
+        printf("%s\n", json);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int failed = 0;
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            failed |= decodeFrame(argv[i]);
+        }
+        return failed;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0]) {
+            failed |= decodeFrame(line);
+        }
+    }
+    return failed;
+}
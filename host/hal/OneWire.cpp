@@ -0,0 +1,158 @@
+#include "OneWire.h"
+
+// ctor()
+OneWire::OneWire(uint16_t pin) {
+    _pin = pin;
+    reset_search();
+}
+
+uint8_t OneWire::reset() {
+    VirtualOneWireBus* bus = VirtualHal::findOneWire(_pin);
+    return bus && bus->reset() ? 1 : 0;
+}
+
+void OneWire::write_bit(uint8_t v) {
+    VirtualOneWireBus* bus = VirtualHal::findOneWire(_pin);
+    if (bus) {
+        bus->writeBit(v & 1);
+    }
+}
+
+// the pull-up holds an empty bus high
+uint8_t OneWire::read_bit() {
+    VirtualOneWireBus* bus = VirtualHal::findOneWire(_pin);
+    return bus ? bus->readBit() & 1 : 1;
+}
+
+// least significant bit first
+void OneWire::write(uint8_t v, uint8_t power) {
+    for (int bit = 0; bit < 8; bit++) {
+        write_bit((v >> bit) & 1);
+    }
+}
+
+void OneWire::write_bytes(const uint8_t* buf, uint16_t count, bool power) {
+    for (uint16_t i = 0; i < count; i++) {
+        write(buf[i], power);
+    }
+}
+
+uint8_t OneWire::read() {
+    uint8_t v = 0;
+    for (int bit = 0; bit < 8; bit++) {
+        v |= read_bit() << bit;
+    }
+    return v;
+}
+
+void OneWire::read_bytes(uint8_t* buf, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        buf[i] = read();
+    }
+}
+
+// Match ROM
+void OneWire::select(const uint8_t rom[8]) {
+    write(0x55);
+    write_bytes(rom, 8);
+}
+
+// Skip ROM
+void OneWire::skip() {
+    write(0xCC);
+}
+
+void OneWire::depower() {
+}
+
+void OneWire::reset_search() {
+    _lastDiscrepancy = 0;
+    _lastFamilyDiscrepancy = 0;
+    _lastDevice = false;
+    memset(_rom, 0, sizeof(_rom));
+}
+
+// Makes the next search start at the first device of the family.
+void OneWire::target_search(uint8_t family_code) {
+    memset(_rom, 0, sizeof(_rom));
+    _rom[0] = family_code;
+    _lastDiscrepancy = 64;
+    _lastFamilyDiscrepancy = 0;
+    _lastDevice = false;
+}
+
+// Search ROM as in Maxim application note 187: every ROM bit is read
+// twice (the bit, then its complement) and a direction written back, which
+// leaves only the devices that match on the bus.
+uint8_t OneWire::search(uint8_t* newAddr) {
+    if (_lastDevice) {
+        reset_search();
+        return 0;
+    }
+    if (!reset()) {
+        reset_search();
+        return 0;
+    }
+
+    write(0xF0);
+
+    uint8_t lastZero = 0;
+    for (uint8_t bitNumber = 1; bitNumber <= 64; bitNumber++) {
+        uint8_t idBit = read_bit();
+        uint8_t complement = read_bit();
+        if (idBit && complement) {
+            // nobody answered
+            reset_search();
+            return 0;
+        }
+
+        uint8_t byteNumber = (bitNumber - 1) / 8;
+        uint8_t mask = 1 << ((bitNumber - 1) % 8);
+        uint8_t direction;
+        if (idBit != complement) {
+            direction = idBit;
+        } else {
+            // devices disagree on this bit, take the branch the last search didn't
+            if (bitNumber < _lastDiscrepancy) {
+                direction = (_rom[byteNumber] & mask) ? 1 : 0;
+            } else {
+                direction = bitNumber == _lastDiscrepancy;
+            }
+            if (direction == 0) {
+                lastZero = bitNumber;
+                if (lastZero < 9) {
+                    _lastFamilyDiscrepancy = lastZero;
+                }
+            }
+        }
+
+        if (direction) {
+            _rom[byteNumber] |= mask;
+        } else {
+            _rom[byteNumber] &= ~mask;
+        }
+        write_bit(direction);
+    }
+
+    _lastDiscrepancy = lastZero;
+    _lastDevice = _lastDiscrepancy == 0;
+    memcpy(newAddr, _rom, 8);
+    return 1;
+}
+
+// Dallas/Maxim CRC8, polynomial x^8 + x^5 + x^4 + 1
+uint8_t OneWire::crc8(const uint8_t* addr, uint8_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+        uint8_t inbyte = *addr++;
+        for (int i = 0; i < 8; i++) {
+            uint8_t mix = (crc ^ inbyte) & 0x01;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            inbyte >>= 1;
+        }
+    }
+    return crc;
+}
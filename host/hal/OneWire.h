@@ -0,0 +1,41 @@
+// The OneWire library API (2.0.1) over the simulated bus the pin is
+// attached to with VirtualHal::attachOneWire(). Bytes, ROM commands and the
+// search are built from single time slots the way the real library does
+// it, so the devices on the bus see exactly the bits the firmware sends.
+
+#include "application.h"
+
+#ifndef OneWire_h
+#define OneWire_h
+
+class OneWire {
+    public:
+        OneWire(uint16_t pin);
+
+        // Returns 1 if a device answered the reset with a presence pulse.
+        uint8_t reset();
+        void select(const uint8_t rom[8]);
+        void skip();
+        void write(uint8_t v, uint8_t power = 0);
+        void write_bytes(const uint8_t* buf, uint16_t count, bool power = 0);
+        uint8_t read();
+        void read_bytes(uint8_t* buf, uint16_t count);
+        void write_bit(uint8_t v);
+        uint8_t read_bit();
+        void depower();
+
+        void reset_search();
+        void target_search(uint8_t family_code);
+        // Finds the next device on the bus, 0 once they have all been found.
+        uint8_t search(uint8_t* newAddr);
+
+        static uint8_t crc8(const uint8_t* addr, uint8_t len);
+    private:
+        uint16_t _pin;
+        uint8_t _rom[8];
+        uint8_t _lastDiscrepancy;
+        uint8_t _lastFamilyDiscrepancy;
+        bool _lastDevice;
+};
+
+#endif
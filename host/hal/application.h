@@ -0,0 +1,177 @@
+// The part of the Particle Device OS API the firmware uses, backed by the
+// simulated hardware in virtual-hal.h. Built with -Ihost/hal ahead of src/,
+// this header stands in for the real one, see virtual-hal.h.
+
+#include "virtual-hal.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <functional>
+
+#ifndef application_h
+#define application_h
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+
+// Photon pin numbers
+enum { D0 = 0, D1, D2, D3, D4, D5, D6, D7 };
+enum { A0 = 10, A1, A2, A3, A4, A5, A6, A7 };
+
+#define LOW 0
+#define HIGH 1
+
+enum PinMode { INPUT, OUTPUT, INPUT_PULLUP, INPUT_PULLDOWN };
+enum InterruptMode { CHANGE, RISING, FALLING };
+enum PublishFlag { PUBLIC, PRIVATE, NO_ACK };
+
+#define DEC 10
+#define HEX 16
+
+// retained memory is ordinary memory here, it lasts as long as the process
+#define retained
+#define STARTUP(x)
+#define SYSTEM_MODE(x)
+#define SYSTEM_THREAD(x)
+#define FEATURE_RETAINED_MEMORY 0
+
+// the cloud answers at once or not at all, there is nothing to wait for
+#define waitFor(condition, timeout) ((condition)())
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint16_t pin, PinMode mode);
+void digitalWrite(uint16_t pin, uint8_t value);
+int32_t digitalRead(uint16_t pin);
+int32_t analogRead(uint16_t pin);
+long map(long value, long fromStart, long fromEnd, long toStart, long toEnd);
+
+bool attachInterrupt(uint16_t pin, std::function<void()> handler, InterruptMode mode);
+void detachInterrupt(uint16_t pin);
+void noInterrupts();
+void interrupts();
+
+template <typename T>
+bool attachInterrupt(uint16_t pin, void (T::*handler)(), T* instance, InterruptMode mode) {
+    return attachInterrupt(pin, std::bind(handler, instance), mode);
+}
+
+inline bool attachInterrupt(uint16_t pin, void (*handler)(), InterruptMode mode) {
+    return attachInterrupt(pin, std::function<void()>(handler), mode);
+}
+
+// Serial output goes to stdout when VirtualHal::setSerialEcho() is on.
+class USBSerial {
+    public:
+        void begin(long baud);
+        int available();
+        size_t write(uint8_t c);
+        size_t print(const char* s);
+        size_t print(char c);
+        size_t print(int value, int base = DEC);
+        size_t print(unsigned int value, int base = DEC);
+        size_t print(long value, int base = DEC);
+        size_t print(unsigned long value, int base = DEC);
+        size_t print(double value, int digits = 2);
+        size_t println(const char* s);
+        size_t println();
+};
+extern USBSerial Serial;
+
+// Transfers go to the VirtualI2cDevice at the address, and take as long
+// as their bits need at the bus clock.
+class TwoWire {
+    public:
+        void begin();
+        void setSpeed(uint32_t clock);
+        void beginTransmission(uint8_t address);
+        void beginTransmission(int address);
+        size_t write(uint8_t data);
+        uint8_t endTransmission(uint8_t stop = true);
+        uint8_t requestFrom(int address, int quantity, int stop = true);
+        int available();
+        int read();
+    private:
+        void holdBus(VirtualI2cDevice* device, int bytes);
+
+        uint32_t _clock;
+        uint8_t _address;
+        uint8_t _buffer[32];
+        int _length;
+        int _position;
+};
+extern TwoWire Wire;
+
+class FuelGauge {
+    public:
+        float getVCell();
+        float getSoC();
+};
+
+class CloudClass {
+    public:
+        void connect();
+        void disconnect();
+        bool connected();
+        void process();
+        bool publish(const char* name, const char* data, PublishFlag flag);
+};
+extern CloudClass Particle;
+extern CloudClass Spark;
+
+class CellularClass {
+    public:
+        void on();
+        void off();
+};
+extern CellularClass Cellular;
+
+class TimeClass {
+    public:
+        uint32_t now();
+        bool isValid();
+};
+extern TimeClass Time;
+
+class SystemClass {
+    public:
+        void enableFeature(int feature);
+        // Stop mode sleep: the clock runs on until the seconds are up or
+        // the pin sees an edge.
+        void sleep(uint16_t wakeUpPin, InterruptMode edge, long seconds);
+        bool wokenUpByPin();
+    private:
+        bool _wokenUpByPin;
+};
+extern SystemClass System;
+
+class EEPROMClass {
+    public:
+        template <typename T>
+        T& get(int address, T& value) {
+            memcpy(&value, VirtualHal::eeprom() + address, sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        const T& put(int address, const T& value) {
+            memcpy(VirtualHal::eeprom() + address, &value, sizeof(T));
+            return value;
+        }
+
+        uint8_t read(int address);
+        void write(int address, uint8_t value);
+        uint16_t length();
+};
+extern EEPROMClass EEPROM;
+
+#endif
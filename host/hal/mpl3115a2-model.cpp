@@ -0,0 +1,327 @@
+#include "mpl3115a2-model.h"
+#include "application.h"
+
+#include <math.h>
+
+// register map, prefixed so they don't clash with the driver's names
+#define REG_STATUS 0x00
+#define REG_OUT_P_MSB 0x01
+#define REG_OUT_T_MSB 0x04
+#define REG_DR_STATUS 0x06
+#define REG_WHO_AM_I 0x0C
+#define REG_F_STATUS 0x0D
+#define REG_F_DATA 0x0E
+#define REG_F_SETUP 0x0F
+#define REG_SYSMOD 0x11
+#define REG_INT_SOURCE 0x12
+#define REG_CTRL_REG1 0x26
+#define REG_CTRL_REG2 0x27
+#define REG_CTRL_REG4 0x29
+#define REG_CTRL_REG5 0x2A
+
+#define WHO_AM_I_VALUE 0xC4
+
+// CTRL_REG1
+#define CTRL1_SBYB 0x01
+#define CTRL1_OST 0x02
+#define CTRL1_RST 0x04
+#define CTRL1_ALT 0x80
+
+// STATUS and DR_STATUS
+#define STATUS_TDR 0x02
+#define STATUS_PDR 0x04
+#define STATUS_PTDR 0x08
+
+// INT_SOURCE, CTRL_REG4 and CTRL_REG5 data ready bit
+#define INT_DRDY 0x80
+
+// ctor()
+Mpl3115a2Model::Mpl3115a2Model() {
+    _pascals = 101325;
+    _celsius = 20;
+    _present = true;
+    _interruptPin = -1;
+    _conversions = 0;
+    reset();
+}
+
+void Mpl3115a2Model::setConditions(float pascals, float celsius) {
+    _pascals = pascals;
+    _celsius = celsius;
+}
+
+void Mpl3115a2Model::setPresent(bool present) {
+    _present = present;
+}
+
+// INT1 is active low, the pull-up holds it high
+void Mpl3115a2Model::attachInterruptPin(int pin) {
+    _interruptPin = pin;
+    VirtualHal::setDigital(pin, HIGH);
+}
+
+uint8_t Mpl3115a2Model::getRegister(uint8_t address) {
+    return address < MPL3115A2_MODEL_REGISTERS ? _registers[address] : 0;
+}
+
+int Mpl3115a2Model::getFifoCount() {
+    return _fifoCount;
+}
+
+unsigned long Mpl3115a2Model::getConversionCount() {
+    return _conversions;
+}
+
+uint8_t Mpl3115a2Model::getAddress() {
+    return MPL3115A2_MODEL_ADDRESS;
+}
+
+bool Mpl3115a2Model::write(const uint8_t* data, int length, bool stop) {
+    if (!_present) {
+        return false;
+    }
+    catchUp();
+    if (length == 0) {
+        return true;
+    }
+
+    _pointer = data[0];
+    for (int i = 1; i < length; i++) {
+        writeRegister(_pointer++, data[i]);
+    }
+    return true;
+}
+
+int Mpl3115a2Model::read(uint8_t* data, int length) {
+    if (!_present) {
+        return 0;
+    }
+    catchUp();
+
+    for (int i = 0; i < length; i++) {
+        // the FIFO is read through one address, the pointer stays on it
+        if (_pointer == REG_F_DATA || (_pointer == REG_OUT_P_MSB && fifoEnabled())) {
+            data[i] = popFifo();
+        } else {
+            data[i] = readRegister(_pointer++);
+        }
+    }
+    return length;
+}
+
+// the next one-shot result or auto-acquisition sample
+uint64_t Mpl3115a2Model::nextEventAt() {
+    uint64_t next = UINT64_MAX;
+    if (_oneShot) {
+        next = _oneShotAt;
+    }
+    if (active() && _nextSampleAt < next) {
+        next = _nextSampleAt;
+    }
+    return next;
+}
+
+void Mpl3115a2Model::fire(uint64_t now) {
+    catchUp();
+}
+
+void Mpl3115a2Model::getConditions(uint64_t at, float* pascals, float* celsius) {
+    *pascals = _pascals;
+    *celsius = _celsius;
+}
+
+void Mpl3115a2Model::reset() {
+    memset(_registers, 0, sizeof(_registers));
+    _registers[REG_WHO_AM_I] = WHO_AM_I_VALUE;
+    _pointer = 0;
+    _oneShot = false;
+    _oneShotAt = 0;
+    _nextSampleAt = 0;
+    _fifoHead = 0;
+    _fifoCount = 0;
+    _fifoByte = 0;
+}
+
+// Takes every sample that came due since the last bus access or event.
+void Mpl3115a2Model::catchUp() {
+    uint64_t now = VirtualHal::clock().now();
+
+    if (_oneShot && _oneShotAt <= now) {
+        _oneShot = false;
+        _registers[REG_CTRL_REG1] &= ~CTRL1_OST;
+        sample(_oneShotAt);
+    }
+
+    while (active() && _nextSampleAt <= now) {
+        sample(_nextSampleAt);
+        _nextSampleAt += (1ULL << (_registers[REG_CTRL_REG2] & 0x0F)) * 1000000;
+    }
+}
+
+// Latches a reading into OUT_P/OUT_T, and the FIFO when it's on.
+void Mpl3115a2Model::sample(uint64_t at) {
+    float pascals, celsius;
+    getConditions(at, &pascals, &celsius);
+    _conversions++;
+
+    // pressure is Q18.2 Pa, altitude Q16.4 m, both left aligned in 24 bits
+    long out;
+    if (_registers[REG_CTRL_REG1] & CTRL1_ALT) {
+        float meters = 44330.77 * (1 - pow(pascals / 101326.0, 0.1902632));
+        out = (lround(meters * 16) & 0xFFFFF) << 4;
+    } else {
+        out = (lround(pascals * 4) & 0xFFFFF) << 4;
+    }
+    // temperature is Q8.4 degC, left aligned in 16 bits
+    int16_t temperature = lround(celsius * 16) * 16;
+
+    uint8_t bytes[5] = {
+        (uint8_t)(out >> 16), (uint8_t)(out >> 8), (uint8_t)out,
+        (uint8_t)(temperature >> 8), (uint8_t)temperature
+    };
+    memcpy(&_registers[REG_OUT_P_MSB], bytes, sizeof(bytes));
+    _registers[REG_STATUS] |= STATUS_PTDR | STATUS_PDR | STATUS_TDR;
+    _registers[REG_DR_STATUS] = _registers[REG_STATUS];
+
+    if (fifoEnabled()) {
+        int mode = _registers[REG_F_SETUP] >> 6;
+        if (_fifoCount == MPL3115A2_MODEL_FIFO) {
+            _registers[REG_F_STATUS] |= 0x80; // F_OVF
+            if (mode == 2) {
+                // stop mode keeps the first 32
+                return;
+            }
+            _fifoHead = (_fifoHead + 1) % MPL3115A2_MODEL_FIFO;
+            _fifoCount--;
+            _fifoByte = 0;
+        }
+        memcpy(_fifo[(_fifoHead + _fifoCount) % MPL3115A2_MODEL_FIFO].bytes, bytes, sizeof(bytes));
+        _fifoCount++;
+    }
+
+    if (_registers[REG_CTRL_REG4] & INT_DRDY) {
+        _registers[REG_INT_SOURCE] |= INT_DRDY;
+        if (_interruptPin >= 0 && (_registers[REG_CTRL_REG5] & INT_DRDY)) {
+            VirtualHal::setDigital(_interruptPin, LOW);
+        }
+    }
+}
+
+void Mpl3115a2Model::writeRegister(uint8_t address, uint8_t value) {
+    if (address >= MPL3115A2_MODEL_REGISTERS) {
+        return;
+    }
+
+    switch (address) {
+        case REG_CTRL_REG1: {
+            if (value & CTRL1_RST) {
+                reset();
+                return;
+            }
+            bool wasActive = active();
+            _registers[REG_CTRL_REG1] = value;
+            _registers[REG_SYSMOD] = active() ? 1 : 0;
+            if (active() && !wasActive) {
+                // the first auto-acquisition sample needs a conversion time
+                _nextSampleAt = VirtualHal::clock().now() + getConversionMicros();
+            }
+            if ((value & CTRL1_OST) && !_oneShot) {
+                _oneShot = true;
+                _oneShotAt = VirtualHal::clock().now() + getConversionMicros();
+            }
+            return;
+        }
+        case REG_F_SETUP:
+            // turning the FIFO off empties it
+            if ((value >> 6) == 0) {
+                _fifoHead = 0;
+                _fifoCount = 0;
+                _fifoByte = 0;
+                _registers[REG_F_STATUS] = 0;
+            }
+            _registers[address] = value;
+            return;
+        case REG_STATUS:
+        case REG_OUT_P_MSB:
+        case REG_OUT_P_MSB + 1:
+        case REG_OUT_P_MSB + 2:
+        case REG_OUT_T_MSB:
+        case REG_OUT_T_MSB + 1:
+        case REG_DR_STATUS:
+        case REG_WHO_AM_I:
+        case REG_F_STATUS:
+        case REG_F_DATA:
+        case REG_SYSMOD:
+        case REG_INT_SOURCE:
+            // read only
+            return;
+        default:
+            _registers[address] = value;
+    }
+}
+
+uint8_t Mpl3115a2Model::readRegister(uint8_t address) {
+    if (address >= MPL3115A2_MODEL_REGISTERS) {
+        return 0;
+    }
+
+    switch (address) {
+        case REG_STATUS:
+            // STATUS is F_STATUS while the FIFO is on
+            return fifoEnabled() ? readRegister(REG_F_STATUS) : _registers[REG_STATUS];
+        case REG_F_STATUS: {
+            uint8_t watermark = _registers[REG_F_SETUP] & 0x3F;
+            uint8_t flags = _registers[REG_F_STATUS] & 0x80;
+            if (watermark > 0 && _fifoCount >= watermark) {
+                flags |= 0x40;
+            }
+            return flags | _fifoCount;
+        }
+        case REG_OUT_P_MSB:
+            // reading the data clears the flags and the interrupt
+            _registers[REG_STATUS] &= ~(STATUS_PTDR | STATUS_PDR);
+            _registers[REG_DR_STATUS] = _registers[REG_STATUS];
+            _registers[REG_INT_SOURCE] &= ~INT_DRDY;
+            if (_interruptPin >= 0) {
+                VirtualHal::setDigital(_interruptPin, HIGH);
+            }
+            return _registers[address];
+        case REG_OUT_T_MSB:
+            _registers[REG_STATUS] &= ~STATUS_TDR;
+            _registers[REG_DR_STATUS] = _registers[REG_STATUS];
+            return _registers[address];
+        default:
+            return _registers[address];
+    }
+}
+
+// The oldest sample a byte at a time, it leaves the FIFO with its last byte.
+uint8_t Mpl3115a2Model::popFifo() {
+    if (_fifoCount == 0) {
+        return 0;
+    }
+
+    uint8_t value = _fifo[_fifoHead].bytes[_fifoByte++];
+    if (_fifoByte == 5) {
+        _fifoByte = 0;
+        _fifoHead = (_fifoHead + 1) % MPL3115A2_MODEL_FIFO;
+        _fifoCount--;
+        // F_OVF clears once the FIFO has been read
+        _registers[REG_F_STATUS] &= ~0x80;
+    }
+    return value;
+}
+
+// 2 + 4 * 2^OS ms, 6 ms without oversampling up to 514 ms at 128 samples
+uint64_t Mpl3115a2Model::getConversionMicros() {
+    int oversample = (_registers[REG_CTRL_REG1] >> 3) & 0x07;
+    return (2 + 4 * (1ULL << oversample)) * 1000;
+}
+
+bool Mpl3115a2Model::active() {
+    return _registers[REG_CTRL_REG1] & CTRL1_SBYB;
+}
+
+bool Mpl3115a2Model::fifoEnabled() {
+    return (_registers[REG_F_SETUP] >> 6) != 0;
+}
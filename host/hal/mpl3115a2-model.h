@@ -0,0 +1,82 @@
+// Simulated MPL3115A2 barometer at 0x60.
+//
+// A register file that behaves like the datasheet's: a write sets the
+// register pointer and writes on from there, reads auto-increment. Setting
+// OST in standby starts a one-shot conversion, which takes 2 + 4 * 2^OS ms
+// for the oversample rate in CTRL_REG1 and then latches OUT_P/OUT_T and
+// sets the STATUS flags. In active mode it samples every 2^ST seconds
+// (CTRL_REG2) on its own, into the 32 sample FIFO when F_SETUP enables it.
+// Reading F_DATA, or OUT_P_MSB while the FIFO is on, pops the oldest
+// sample 5 bytes at a time and F_STATUS counts what's left.
+//
+// The model is also a clock event source: add it with
+// VirtualHal::clock().addSource() and samples are taken on time while the
+// firmware sleeps, and the data ready interrupt fires on the pin given to
+// attachInterruptPin().
+
+#include "virtual-hal.h"
+
+#ifndef Mpl3115a2Model_h
+#define Mpl3115a2Model_h
+
+#define MPL3115A2_MODEL_ADDRESS 0x60
+#define MPL3115A2_MODEL_REGISTERS 0x30
+#define MPL3115A2_MODEL_FIFO 32
+
+class Mpl3115a2Model : public VirtualI2cDevice, public VirtualEventSource {
+    public:
+        Mpl3115a2Model();
+
+        // Fixed conditions, see getConditions().
+        void setConditions(float pascals, float celsius);
+        void setPresent(bool present);
+        void attachInterruptPin(int pin);
+
+        uint8_t getRegister(uint8_t address);
+        int getFifoCount();
+        unsigned long getConversionCount();
+
+        uint8_t getAddress();
+        bool write(const uint8_t* data, int length, bool stop);
+        int read(uint8_t* data, int length);
+
+        uint64_t nextEventAt();
+        void fire(uint64_t now);
+    protected:
+        // The air at a point in virtual time, override to play a pressure
+        // series back.
+        virtual void getConditions(uint64_t at, float* pascals, float* celsius);
+    private:
+        struct Sample {
+            uint8_t bytes[5];
+        };
+
+        void reset();
+        void catchUp();
+        void sample(uint64_t at);
+        void writeRegister(uint8_t address, uint8_t value);
+        uint8_t readRegister(uint8_t address);
+        uint8_t popFifo();
+        uint64_t getConversionMicros();
+        bool active();
+        bool fifoEnabled();
+
+        float _pascals;
+        float _celsius;
+        bool _present;
+        int _interruptPin;
+
+        uint8_t _registers[MPL3115A2_MODEL_REGISTERS];
+        uint8_t _pointer;
+        bool _oneShot;
+        uint64_t _oneShotAt;
+        uint64_t _nextSampleAt;
+
+        Sample _fifo[MPL3115A2_MODEL_FIFO];
+        int _fifoHead;
+        int _fifoCount;
+        int _fifoByte;
+        unsigned long _conversions;
+};
+
+#endif
@@ -0,0 +1,545 @@
+#include "one-wire-models.h"
+
+#include <math.h>
+#include <string.h>
+
+// ROM commands
+#define ROM_READ 0x33
+#define ROM_MATCH 0x55
+#define ROM_SKIP 0xCC
+#define ROM_SEARCH 0xF0
+
+// function commands, the DS2438 follows most of them with a page number
+#define COMMAND_CONVERT_T 0x44
+#define COMMAND_CONVERT_V 0xB4
+#define COMMAND_WRITE_SCRATCHPAD 0x4E
+#define COMMAND_READ_SCRATCHPAD 0xBE
+#define COMMAND_COPY_SCRATCHPAD 0x48
+#define COMMAND_RECALL 0xB8
+
+// datasheet maximum conversion times in us, the DS18B20 and DS1822 indexed
+// by the R1:R0 bits of the configuration register (9 to 12 bits)
+static const uint32_t DS18B20_CONVERSION_MICROS[] = { 93750, 187500, 375000, 750000 };
+#define DS18S20_CONVERSION_MICROS 750000
+#define DS2438_TEMPERATURE_MICROS 10000
+#define DS2438_VOLTAGE_MICROS 4000
+
+// ctor()
+OneWireDeviceModel::OneWireDeviceModel(uint8_t family, uint64_t serial) {
+    _rom[0] = family;
+    for (int i = 1; i < 7; i++) {
+        _rom[i] = (serial >> ((i - 1) * 8)) & 0xFF;
+    }
+    _rom[7] = crc8(_rom, 7);
+    _present = true;
+    _crcFaults = 0;
+    _searches = 0;
+    _state = STATE_IDLE;
+    _byte = 0;
+    _bits = 0;
+    _romBit = 0;
+    _searchPhase = 0;
+    _command = 0;
+    _argumentCount = 0;
+    _argumentsExpected = 0;
+    _outputBits = 0;
+    _outputBit = 0;
+    _busyUntil = 0;
+}
+
+const uint8_t* OneWireDeviceModel::getRom() {
+    return _rom;
+}
+
+void OneWireDeviceModel::setPresent(bool present) {
+    _present = present;
+    _state = STATE_IDLE;
+}
+
+void OneWireDeviceModel::injectCrcFaults(int count) {
+    _crcFaults = count;
+}
+
+unsigned long OneWireDeviceModel::getSearchCount() {
+    return _searches;
+}
+
+// A reset puts every device back to waiting for a ROM command, a conversion
+// in progress carries on.
+bool OneWireDeviceModel::reset() {
+    if (!_present) {
+        return false;
+    }
+    _state = STATE_ROM_COMMAND;
+    _byte = 0;
+    _bits = 0;
+    _outputBits = 0;
+    _outputBit = 0;
+    return true;
+}
+
+void OneWireDeviceModel::writeBit(uint8_t bit) {
+    if (!_present) {
+        return;
+    }
+
+    switch (_state) {
+        case STATE_ROM_COMMAND:
+        case STATE_FUNCTION:
+        case STATE_ARGUMENTS:
+            // least significant bit first
+            _byte |= (bit & 1) << _bits;
+            if (++_bits == 8) {
+                uint8_t value = _byte;
+                _byte = 0;
+                _bits = 0;
+                receiveByte(value);
+            }
+            return;
+        case STATE_MATCH_ROM:
+            // any other ROM and the device sits out until the next reset
+            if ((bit & 1) != ((_rom[_romBit / 8] >> (_romBit % 8)) & 1)) {
+                _state = STATE_IDLE;
+            } else if (++_romBit == 64) {
+                _state = STATE_FUNCTION;
+            }
+            return;
+        case STATE_SEARCH_ROM:
+            // the master writes the direction it took after the two reads,
+            // the devices on the other branch drop out
+            if (_searchPhase != 2 || (bit & 1) != ((_rom[_romBit / 8] >> (_romBit % 8)) & 1)) {
+                _state = STATE_IDLE;
+                return;
+            }
+            _searchPhase = 0;
+            if (++_romBit == 64) {
+                _state = STATE_FUNCTION;
+            }
+            return;
+        default:
+            return;
+    }
+}
+
+uint8_t OneWireDeviceModel::readBit() {
+    if (!_present) {
+        return 1;
+    }
+
+    switch (_state) {
+        case STATE_SEARCH_ROM: {
+            // each ROM bit then its complement
+            uint8_t bit = (_rom[_romBit / 8] >> (_romBit % 8)) & 1;
+            if (_searchPhase == 0) {
+                _searchPhase = 1;
+                return bit;
+            }
+            if (_searchPhase == 1) {
+                _searchPhase = 2;
+                return bit ^ 1;
+            }
+            return 1;
+        }
+        case STATE_FUNCTION:
+        case STATE_ARGUMENTS:
+            if (_outputBit < _outputBits) {
+                uint8_t bit = (_output[_outputBit / 8] >> (_outputBit % 8)) & 1;
+                _outputBit++;
+                return bit;
+            }
+            // a powered device holds read slots low while it's converting
+            return VirtualHal::clock().now() < _busyUntil ? 0 : 1;
+        default:
+            return 1;
+    }
+}
+
+void OneWireDeviceModel::expectArguments(int count) {
+    _state = STATE_ARGUMENTS;
+    _argumentCount = 0;
+    _argumentsExpected = count < (int)sizeof(_arguments) ? count : sizeof(_arguments);
+}
+
+void OneWireDeviceModel::send(const uint8_t* data, int length) {
+    if (_outputBit == _outputBits) {
+        _outputBits = 0;
+        _outputBit = 0;
+    }
+    for (int i = 0; i < length && _outputBits < (int)sizeof(_output) * 8; i++) {
+        _output[_outputBits / 8] = data[i];
+        _outputBits += 8;
+    }
+}
+
+void OneWireDeviceModel::sendCrc(uint8_t crc) {
+    if (_crcFaults > 0) {
+        crc ^= 0xFF;
+        _crcFaults--;
+    }
+    send(&crc, 1);
+}
+
+void OneWireDeviceModel::setBusyUntil(uint64_t at) {
+    _busyUntil = at;
+}
+
+void OneWireDeviceModel::receiveByte(uint8_t value) {
+    switch (_state) {
+        case STATE_ROM_COMMAND:
+            switch (value) {
+                case ROM_READ:
+                    // only works with one device on the bus, the others
+                    // answer at the same time
+                    _state = STATE_FUNCTION;
+                    send(_rom, 8);
+                    return;
+                case ROM_MATCH:
+                    _state = STATE_MATCH_ROM;
+                    _romBit = 0;
+                    return;
+                case ROM_SKIP:
+                    _state = STATE_FUNCTION;
+                    return;
+                case ROM_SEARCH:
+                    _state = STATE_SEARCH_ROM;
+                    _searches++;
+                    _romBit = 0;
+                    _searchPhase = 0;
+                    return;
+                default:
+                    // no alarms are ever set, so the alarm search and
+                    // anything unknown leave the device out
+                    _state = STATE_IDLE;
+                    return;
+            }
+        case STATE_FUNCTION:
+            _command = value;
+            _outputBits = 0;
+            _outputBit = 0;
+            command(value);
+            return;
+        case STATE_ARGUMENTS:
+            _arguments[_argumentCount++] = value;
+            if (_argumentCount == _argumentsExpected) {
+                _state = STATE_FUNCTION;
+                arguments(_command, _arguments, _argumentCount);
+            }
+            return;
+        default:
+            return;
+    }
+}
+
+// Dallas/Maxim CRC-8, x^8 + x^5 + x^4 + 1, least significant bit first
+uint8_t OneWireDeviceModel::crc8(const uint8_t* data, int length) {
+    uint8_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        uint8_t in = data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            uint8_t mix = (crc ^ in) & 0x01;
+            crc >>= 1;
+            if (mix) {
+                crc ^= 0x8C;
+            }
+            in >>= 1;
+        }
+    }
+    return crc;
+}
+
+// ctor()
+Ds18x20Model::Ds18x20Model(uint8_t family, uint64_t serial) : OneWireDeviceModel(family, serial) {
+    _family = family;
+    _celsius = 20;
+    _conversions = 0;
+    _pending = false;
+    _readyAt = 0;
+    _pendingRaw = 0;
+    _pendingRemain = 0x0C;
+
+    // the power on scratchpad reads 85 degC until the first conversion
+    if (family == FAMILY_DS18S20) {
+        uint8_t power[] = { 0xAA, 0x00, 0x4B, 0x46, 0xFF, 0xFF, 0x0C, 0x10 };
+        memcpy(_scratchpad, power, sizeof(power));
+    } else {
+        uint8_t power[] = { 0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10 };
+        memcpy(_scratchpad, power, sizeof(power));
+    }
+    _scratchpad[8] = crc8(_scratchpad, 8);
+    memcpy(_eeprom, &_scratchpad[2], sizeof(_eeprom));
+}
+
+void Ds18x20Model::setTemperature(float celsius) {
+    _celsius = celsius;
+}
+
+// The configuration register is byte 4, R1:R0 in bits 6 and 5.
+void Ds18x20Model::setResolution(int bits) {
+    if (_family == FAMILY_DS18S20 || bits < 9 || bits > 12) {
+        return;
+    }
+    _scratchpad[4] = ((bits - 9) << 5) | 0x1F;
+    _scratchpad[8] = crc8(_scratchpad, 8);
+    _eeprom[2] = _scratchpad[4];
+}
+
+unsigned long Ds18x20Model::getConversionCount() {
+    return _conversions;
+}
+
+float Ds18x20Model::getTemperature(uint64_t at) {
+    return _celsius;
+}
+
+void Ds18x20Model::command(uint8_t code) {
+    finishConversion();
+
+    switch (code) {
+        case COMMAND_CONVERT_T:
+            startConversion();
+            return;
+        case COMMAND_READ_SCRATCHPAD:
+            send(_scratchpad, 8);
+            sendCrc(_scratchpad[8]);
+            return;
+        case COMMAND_WRITE_SCRATCHPAD:
+            // TH and TL, and the configuration register but on the DS18S20
+            expectArguments(_family == FAMILY_DS18S20 ? 2 : 3);
+            return;
+        case COMMAND_COPY_SCRATCHPAD:
+            memcpy(_eeprom, &_scratchpad[2], sizeof(_eeprom));
+            return;
+        case COMMAND_RECALL:
+            memcpy(&_scratchpad[2], _eeprom, _family == FAMILY_DS18S20 ? 2 : 3);
+            _scratchpad[8] = crc8(_scratchpad, 8);
+            return;
+        default:
+            // Read Power Supply answers its slot high, externally powered
+            return;
+    }
+}
+
+void Ds18x20Model::arguments(uint8_t code, const uint8_t* data, int length) {
+    if (code != COMMAND_WRITE_SCRATCHPAD) {
+        return;
+    }
+    _scratchpad[2] = data[0];
+    _scratchpad[3] = data[1];
+    if (length > 2) {
+        // only R1:R0 can be written, the rest of the register reads as ones
+        _scratchpad[4] = (data[2] & 0x60) | 0x1F;
+    }
+    _scratchpad[8] = crc8(_scratchpad, 8);
+}
+
+// The temperature is taken when the conversion starts and lands in the
+// scratchpad once the conversion time for the resolution has passed.
+void Ds18x20Model::startConversion() {
+    float celsius = getTemperature(VirtualHal::clock().now());
+    _conversions++;
+
+    if (_family == FAMILY_DS18S20) {
+        // 9 bits in half degrees, COUNT_REMAIN makes up the rest with
+        // T = TEMP_READ - 0.25 + (COUNT_PER_C - COUNT_REMAIN) / COUNT_PER_C
+        long half = lround(celsius * 2);
+        float whole = floor(half / 2.0);
+        long remain = 12 - lround((celsius - whole) * 16);
+        _pendingRaw = (int16_t)half;
+        _pendingRemain = remain < 0 ? 0 : (remain > 16 ? 16 : remain);
+    } else {
+        // sixteenths of a degree, the bits below the resolution are left undefined
+        int resolution = (_scratchpad[4] >> 5) & 0x03;
+        _pendingRaw = (int16_t)lround(celsius * 16) & ~((1 << (3 - resolution)) - 1);
+        _pendingRemain = _scratchpad[6];
+    }
+
+    _pending = true;
+    _readyAt = VirtualHal::clock().now() + getConversionMicros();
+    setBusyUntil(_readyAt);
+}
+
+void Ds18x20Model::finishConversion() {
+    if (!_pending || VirtualHal::clock().now() < _readyAt) {
+        return;
+    }
+    _pending = false;
+    _scratchpad[0] = _pendingRaw & 0xFF;
+    _scratchpad[1] = (_pendingRaw >> 8) & 0xFF;
+    _scratchpad[6] = _pendingRemain;
+    _scratchpad[8] = crc8(_scratchpad, 8);
+}
+
+uint32_t Ds18x20Model::getConversionMicros() {
+    if (_family == FAMILY_DS18S20) {
+        return DS18S20_CONVERSION_MICROS;
+    }
+    return DS18B20_CONVERSION_MICROS[(_scratchpad[4] >> 5) & 0x03];
+}
+
+// ctor()
+Ds2438Model::Ds2438Model(uint64_t serial) : OneWireDeviceModel(FAMILY_DS2438, serial) {
+    _celsius = 20;
+    _conversions = 0;
+    _pending = false;
+    _readyAt = 0;
+    _pendingRaw = 0;
+
+    // IAD, CA, EE and AD set, registers zeroed
+    memset(_page0, 0, sizeof(_page0));
+    _page0[0] = 0x0F;
+    memcpy(_scratchpad, _page0, sizeof(_scratchpad));
+}
+
+void Ds2438Model::setTemperature(float celsius) {
+    _celsius = celsius;
+}
+
+unsigned long Ds2438Model::getConversionCount() {
+    return _conversions;
+}
+
+float Ds2438Model::getTemperature(uint64_t at) {
+    return _celsius;
+}
+
+void Ds2438Model::command(uint8_t code) {
+    finishConversion();
+
+    switch (code) {
+        case COMMAND_CONVERT_T:
+            _pendingRaw = (int16_t)(lround(getTemperature(VirtualHal::clock().now()) * 32) * 8);
+            _conversions++;
+            _pending = true;
+            _readyAt = VirtualHal::clock().now() + DS2438_TEMPERATURE_MICROS;
+            // TB is set while the temperature converts
+            _page0[0] |= 0x10;
+            setBusyUntil(_readyAt);
+            return;
+        case COMMAND_CONVERT_V:
+            // the battery input isn't modelled, it only takes the time
+            setBusyUntil(VirtualHal::clock().now() + DS2438_VOLTAGE_MICROS);
+            return;
+        case COMMAND_READ_SCRATCHPAD:
+        case COMMAND_RECALL:
+        case COMMAND_COPY_SCRATCHPAD:
+            expectArguments(1);
+            return;
+        case COMMAND_WRITE_SCRATCHPAD:
+            // the page then up to 8 bytes
+            expectArguments(9);
+            return;
+        default:
+            return;
+    }
+}
+
+// Only page 0 is modelled, the other pages read as zeros.
+void Ds2438Model::arguments(uint8_t code, const uint8_t* data, int length) {
+    finishConversion();
+    uint8_t page = data[0];
+
+    switch (code) {
+        case COMMAND_RECALL:
+            if (page == 0) {
+                memcpy(_scratchpad, _page0, sizeof(_scratchpad));
+            } else {
+                memset(_scratchpad, 0, sizeof(_scratchpad));
+            }
+            return;
+        case COMMAND_READ_SCRATCHPAD:
+            send(_scratchpad, sizeof(_scratchpad));
+            sendCrc(crc8(_scratchpad, sizeof(_scratchpad)));
+            return;
+        case COMMAND_WRITE_SCRATCHPAD:
+            memcpy(_scratchpad, &data[1], length - 1);
+            return;
+        case COMMAND_COPY_SCRATCHPAD:
+            // the configuration bits and the threshold are all that's writable
+            if (page == 0) {
+                _page0[0] = (_page0[0] & ~0x0F) | (_scratchpad[0] & 0x0F);
+                _page0[7] = _scratchpad[7];
+            }
+            return;
+        default:
+            return;
+    }
+}
+
+// 13 bits in 1/32 degC, left aligned in bytes 1 and 2 of page 0
+void Ds2438Model::finishConversion() {
+    if (!_pending || VirtualHal::clock().now() < _readyAt) {
+        return;
+    }
+    _pending = false;
+    _page0[0] &= ~0x10;
+    _page0[1] = _pendingRaw & 0xFF;
+    _page0[2] = (_pendingRaw >> 8) & 0xFF;
+}
+
+// ctor()
+OneWireModelBus::OneWireModelBus() {
+    _deviceCount = 0;
+    resetCounters();
+}
+
+bool OneWireModelBus::attach(OneWireDeviceModel* device) {
+    if (_deviceCount == ONE_WIRE_MODEL_DEVICES) {
+        return false;
+    }
+    _devices[_deviceCount++] = device;
+    return true;
+}
+
+// 480 us low, then 480 us listening for presence pulses
+bool OneWireModelBus::reset() {
+    _resets++;
+    _busMicros += ONE_WIRE_RESET_MICROS;
+    VirtualHal::clock().advance(ONE_WIRE_RESET_MICROS);
+
+    bool present = false;
+    for (int i = 0; i < _deviceCount; i++) {
+        present |= _devices[i]->reset();
+    }
+    return present;
+}
+
+void OneWireModelBus::writeBit(uint8_t bit) {
+    _slots++;
+    _busMicros += ONE_WIRE_SLOT_MICROS;
+    VirtualHal::clock().advance(ONE_WIRE_SLOT_MICROS);
+
+    for (int i = 0; i < _deviceCount; i++) {
+        _devices[i]->writeBit(bit);
+    }
+}
+
+// every device sees the slot, any one of them pulling low wins
+uint8_t OneWireModelBus::readBit() {
+    _slots++;
+    _busMicros += ONE_WIRE_SLOT_MICROS;
+    VirtualHal::clock().advance(ONE_WIRE_SLOT_MICROS);
+
+    uint8_t bit = 1;
+    for (int i = 0; i < _deviceCount; i++) {
+        bit &= _devices[i]->readBit();
+    }
+    return bit;
+}
+
+unsigned long OneWireModelBus::getResetCount() {
+    return _resets;
+}
+
+unsigned long OneWireModelBus::getSlotCount() {
+    return _slots;
+}
+
+uint64_t OneWireModelBus::getBusMicros() {
+    return _busMicros;
+}
+
+void OneWireModelBus::resetCounters() {
+    _resets = 0;
+    _slots = 0;
+    _busMicros = 0;
+}
@@ -0,0 +1,171 @@
+// Simulated 1-Wire bus and the soil probe chips that sit on it.
+//
+// OneWireModelBus is the VirtualOneWireBus for a pin. Every reset and time
+// slot takes its standard speed duration on the virtual clock (480 us low,
+// 480 us for the presence pulse, 70 us per slot) and is counted, and a read
+// slot returns the wired-AND of every device, so the search arbitrates the
+// way it does on a real bus.
+//
+// Each device runs the ROM layer bit by bit: Read ROM, Match ROM, Skip ROM
+// and Search ROM, then hands function commands to its chip model. The chip
+// models keep a scratchpad with its CRC, take their datasheet conversion
+// time for Convert T, and can be made to send bad CRCs or drop off the bus.
+
+#include "virtual-hal.h"
+
+#ifndef OneWireModels_h
+#define OneWireModels_h
+
+#define ONE_WIRE_MODEL_DEVICES 8
+#define ONE_WIRE_RESET_MICROS 960
+#define ONE_WIRE_SLOT_MICROS 70
+
+// family codes, the first ROM byte
+#define FAMILY_DS18S20 0x10
+#define FAMILY_DS1822 0x22
+#define FAMILY_DS2438 0x26
+#define FAMILY_DS18B20 0x28
+
+class OneWireDeviceModel {
+    public:
+        // The ROM is the family code, the 48 bit serial number and their CRC.
+        OneWireDeviceModel(uint8_t family, uint64_t serial);
+        virtual ~OneWireDeviceModel() {}
+
+        const uint8_t* getRom();
+        // A device off the bus (a cut cable, a flooded probe) doesn't answer
+        // resets and leaves every slot high.
+        void setPresent(bool present);
+        // Corrupts the CRC of the next count scratchpad reads.
+        void injectCrcFaults(int count);
+        // Search ROM commands this device took part in.
+        unsigned long getSearchCount();
+
+        bool reset();
+        void writeBit(uint8_t bit);
+        uint8_t readBit();
+    protected:
+        // Called with each function command byte after the ROM layer
+        // selected the device.
+        virtual void command(uint8_t code) = 0;
+        // Called once the bytes asked for with expectArguments() are in.
+        virtual void arguments(uint8_t code, const uint8_t* data, int length) {}
+
+        void expectArguments(int count);
+        // Queues bytes for the master to read, the CRC byte of a
+        // scratchpad goes through sendCrc() so faults can be injected.
+        void send(const uint8_t* data, int length);
+        void sendCrc(uint8_t crc);
+        // Read slots answer 0 until then while the device is busy.
+        void setBusyUntil(uint64_t at);
+
+        static uint8_t crc8(const uint8_t* data, int length);
+    private:
+        enum State { STATE_IDLE, STATE_ROM_COMMAND, STATE_MATCH_ROM, STATE_SEARCH_ROM, STATE_FUNCTION, STATE_ARGUMENTS };
+
+        uint8_t _rom[8];
+        bool _present;
+        int _crcFaults;
+        unsigned long _searches;
+
+        State _state;
+        uint8_t _byte;
+        int _bits;
+        int _romBit;
+        int _searchPhase;
+        uint8_t _command;
+        uint8_t _arguments[16];
+        int _argumentCount;
+        int _argumentsExpected;
+
+        uint8_t _output[16];
+        int _outputBits;
+        int _outputBit;
+        uint64_t _busyUntil;
+
+        void receiveByte(uint8_t value);
+};
+
+// DS18B20, DS1822 or DS18S20 temperature sensor.
+class Ds18x20Model : public OneWireDeviceModel {
+    public:
+        Ds18x20Model(uint8_t family, uint64_t serial);
+
+        void setTemperature(float celsius);
+        // 9 to 12 bits, the DS18S20 is fixed at 9 bits plus COUNT_REMAIN.
+        void setResolution(int bits);
+        unsigned long getConversionCount();
+    protected:
+        // The temperature when a conversion starts, override to play a
+        // series back.
+        virtual float getTemperature(uint64_t at);
+
+        void command(uint8_t code);
+        void arguments(uint8_t code, const uint8_t* data, int length);
+    private:
+        void startConversion();
+        void finishConversion();
+        uint32_t getConversionMicros();
+
+        uint8_t _family;
+        float _celsius;
+        uint8_t _scratchpad[9];
+        // TH, TL and the configuration register
+        uint8_t _eeprom[3];
+        unsigned long _conversions;
+
+        bool _pending;
+        uint64_t _readyAt;
+        int16_t _pendingRaw;
+        uint8_t _pendingRemain;
+};
+
+// DS2438 battery monitor, used for its temperature sensor.
+class Ds2438Model : public OneWireDeviceModel {
+    public:
+        Ds2438Model(uint64_t serial);
+
+        void setTemperature(float celsius);
+        unsigned long getConversionCount();
+    protected:
+        virtual float getTemperature(uint64_t at);
+
+        void command(uint8_t code);
+        void arguments(uint8_t code, const uint8_t* data, int length);
+    private:
+        void finishConversion();
+
+        float _celsius;
+        uint8_t _page0[8];
+        uint8_t _scratchpad[8];
+        unsigned long _conversions;
+
+        bool _pending;
+        uint64_t _readyAt;
+        int16_t _pendingRaw;
+};
+
+// The devices on one pin and the time they have held the bus.
+class OneWireModelBus : public VirtualOneWireBus {
+    public:
+        OneWireModelBus();
+
+        bool attach(OneWireDeviceModel* device);
+
+        bool reset();
+        void writeBit(uint8_t bit);
+        uint8_t readBit();
+
+        unsigned long getResetCount();
+        unsigned long getSlotCount();
+        uint64_t getBusMicros();
+        void resetCounters();
+    private:
+        OneWireDeviceModel* _devices[ONE_WIRE_MODEL_DEVICES];
+        int _deviceCount;
+        unsigned long _resets;
+        unsigned long _slots;
+        uint64_t _busMicros;
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include "si7021-model.h"
+
+#include <math.h>
+
+// user register after power up and reset
+#define SI7021_USER_REGISTER_DEFAULT 0x3A
+#define HTU21D_USER_REGISTER_DEFAULT 0x02
+// RES1, HTRE and RES0 are the only bits that can be written
+#define USER_REGISTER_WRITABLE 0x85
+
+#define SOFT_RESET_MICROS 15000
+
+// datasheet maximum conversion times in us, indexed by the RES1:RES0 bits
+// of the user register (12/14, 8/12, 10/13 and 11/11 bit RH/temperature)
+static const uint32_t SI7021_HUMIDITY_MICROS[] = { 12000, 3100, 4500, 7000 };
+static const uint32_t SI7021_TEMPERATURE_MICROS[] = { 10800, 3800, 6200, 2400 };
+static const uint32_t HTU21D_HUMIDITY_MICROS[] = { 16000, 3000, 5000, 8000 };
+static const uint32_t HTU21D_TEMPERATURE_MICROS[] = { 50000, 13000, 25000, 7000 };
+static const uint8_t HUMIDITY_BITS[] = { 12, 8, 10, 11 };
+static const uint8_t TEMPERATURE_BITS[] = { 14, 12, 13, 11 };
+
+// the second byte of the electronic ID's second half, SNB_3
+static const uint8_t DEVICE_ID[] = { 0x15, 0x32 };
+
+// ctor()
+Si7021Model::Si7021Model(HumiditySensorKind kind) {
+    _kind = kind;
+    _humidity = 50;
+    _celsius = 20;
+    _present = true;
+    _crcFaults = 0;
+    _userRegister = kind == HUMIDITY_SI7021 ? SI7021_USER_REGISTER_DEFAULT : HTU21D_USER_REGISTER_DEFAULT;
+    _pending = PENDING_NONE;
+    _hold = false;
+    _readyAt = 0;
+    _result = 0;
+    _previousTemperature = 0;
+    _conversions = 0;
+}
+
+void Si7021Model::setConditions(float humidity, float celsius) {
+    _humidity = humidity;
+    _celsius = celsius;
+}
+
+void Si7021Model::injectCrcFaults(int count) {
+    _crcFaults = count;
+}
+
+void Si7021Model::setPresent(bool present) {
+    _present = present;
+}
+
+uint8_t Si7021Model::getUserRegister() {
+    return _userRegister;
+}
+
+unsigned long Si7021Model::getConversionCount() {
+    return _conversions;
+}
+
+uint8_t Si7021Model::getAddress() {
+    return SI7021_MODEL_ADDRESS;
+}
+
+bool Si7021Model::write(const uint8_t* data, int length, bool stop) {
+    if (!_present) {
+        return false;
+    }
+    // an address only write, a probe
+    if (length == 0) {
+        return true;
+    }
+    // busy with a reset
+    if (VirtualHal::clock().now() < _readyAt && _pending == PENDING_NONE) {
+        return false;
+    }
+
+    switch (data[0]) {
+        case 0xE5:
+        case 0xF5:
+            startConversion(true, data[0] == 0xE5);
+            return true;
+        case 0xE3:
+        case 0xF3:
+            startConversion(false, data[0] == 0xE3);
+            return true;
+        case 0xE0:
+            // the HTU21D doesn't know this one
+            if (_kind != HUMIDITY_SI7021) {
+                return false;
+            }
+            _pending = PENDING_PREVIOUS;
+            return true;
+        case 0xE6:
+            if (length < 2) {
+                return false;
+            }
+            _userRegister = (data[1] & USER_REGISTER_WRITABLE) | (_userRegister & ~USER_REGISTER_WRITABLE);
+            _pending = PENDING_NONE;
+            return true;
+        case 0xE7:
+            _pending = PENDING_USER_REGISTER;
+            return true;
+        case 0xFE:
+            _userRegister = _kind == HUMIDITY_SI7021 ? SI7021_USER_REGISTER_DEFAULT : HTU21D_USER_REGISTER_DEFAULT;
+            _pending = PENDING_NONE;
+            _readyAt = VirtualHal::clock().now() + SOFT_RESET_MICROS;
+            return true;
+        case 0xFC:
+            if (length < 2 || data[1] != 0xC9) {
+                return false;
+            }
+            _pending = PENDING_ID;
+            return true;
+        default:
+            return false;
+    }
+}
+
+int Si7021Model::read(uint8_t* data, int length) {
+    if (!_present || length <= 0) {
+        return 0;
+    }
+
+    uint8_t reply[3];
+    int replyLength;
+    switch (_pending) {
+        case PENDING_HUMIDITY:
+        case PENDING_TEMPERATURE:
+            if (VirtualHal::clock().now() < _readyAt) {
+                if (!_hold) {
+                    return 0;
+                }
+                // a hold command stretches the clock through the conversion
+                VirtualHal::clock().advanceTo(_readyAt);
+            }
+            reply[0] = _result >> 8;
+            reply[1] = _result & 0xFF;
+            reply[2] = crc8(reply, 2);
+            if (_crcFaults > 0) {
+                reply[2] ^= 0xFF;
+                _crcFaults--;
+            }
+            replyLength = 3;
+            _pending = PENDING_NONE;
+            break;
+        case PENDING_PREVIOUS:
+            reply[0] = _previousTemperature >> 8;
+            reply[1] = _previousTemperature & 0xFF;
+            replyLength = 2;
+            _pending = PENDING_NONE;
+            break;
+        case PENDING_USER_REGISTER:
+            reply[0] = _userRegister;
+            replyLength = 1;
+            break;
+        case PENDING_ID:
+            reply[0] = DEVICE_ID[_kind];
+            reply[1] = 0xFF;
+            reply[2] = 0xFF;
+            replyLength = 3;
+            break;
+        default:
+            return 0;
+    }
+
+    // past the reply the master only clocks in ones
+    for (int i = 0; i < length; i++) {
+        data[i] = i < replyLength ? reply[i] : 0xFF;
+    }
+    return length;
+}
+
+// The reading is taken when the conversion starts, the result is ready
+// once the conversion time has passed. The Si7021 measures temperature as
+// part of every humidity conversion, which E0 reads back later.
+void Si7021Model::startConversion(bool humidity, bool hold) {
+    _pending = humidity ? PENDING_HUMIDITY : PENDING_TEMPERATURE;
+    _hold = hold;
+    _readyAt = VirtualHal::clock().now() + getConversionMicros(humidity);
+    _result = humidity ? humidityCode() : temperatureCode();
+    if (humidity && _kind == HUMIDITY_SI7021) {
+        _previousTemperature = temperatureCode();
+    }
+    _conversions++;
+}
+
+uint32_t Si7021Model::getConversionMicros(bool humidity) {
+    int resolution = ((_userRegister >> 6) & 0x02) | (_userRegister & 0x01);
+    if (_kind == HUMIDITY_HTU21D) {
+        return humidity ? HTU21D_HUMIDITY_MICROS[resolution] : HTU21D_TEMPERATURE_MICROS[resolution];
+    }
+    return humidity ? SI7021_HUMIDITY_MICROS[resolution] + SI7021_TEMPERATURE_MICROS[resolution] : SI7021_TEMPERATURE_MICROS[resolution];
+}
+
+static uint16_t toCode(double value, int bits) {
+    long code = lround(value);
+    code = code < 0 ? 0 : (code > 0xFFFF ? 0xFFFF : code);
+    // bits below the resolution read as zero, the two status bits included
+    uint16_t mask = (0xFFFF << (16 - bits)) & 0xFFFC;
+    return code & mask;
+}
+
+// RH = 125 * code / 65536 - 6, the two status bits are 10 for humidity
+uint16_t Si7021Model::humidityCode() {
+    int resolution = ((_userRegister >> 6) & 0x02) | (_userRegister & 0x01);
+    return toCode((_humidity + 6) * 65536 / 125, HUMIDITY_BITS[resolution]) | 0x02;
+}
+
+// T = 175.72 * code / 65536 - 46.85
+uint16_t Si7021Model::temperatureCode() {
+    int resolution = ((_userRegister >> 6) & 0x02) | (_userRegister & 0x01);
+    return toCode((_celsius + 46.85) * 65536 / 175.72, TEMPERATURE_BITS[resolution]);
+}
+
+uint8_t Si7021Model::crc8(const uint8_t* data, int length) {
+    uint8_t crc = 0;
+    for (int i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+    }
+    return crc;
+}
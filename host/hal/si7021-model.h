@@ -0,0 +1,61 @@
+// Simulated Si7021 or HTU21D humidity and temperature sensor at 0x40.
+//
+// Follows the datasheet command set: measurements with (E5/E3) and without
+// (F5/F3) clock stretching, the temperature of the last humidity
+// conversion (E0, Si7021 only), the user register (E6/E7), soft reset (FE)
+// and the electronic ID (FC C9). A no hold measurement NACKs its read until
+// the conversion time for the resolution in the user register has passed
+// on the virtual clock, a hold measurement stretches the clock until then.
+// Results carry the CRC-8 the parts send (x^8 + x^5 + x^4 + 1).
+
+#include "virtual-hal.h"
+
+#ifndef Si7021Model_h
+#define Si7021Model_h
+
+#define SI7021_MODEL_ADDRESS 0x40
+
+enum HumiditySensorKind { HUMIDITY_SI7021, HUMIDITY_HTU21D };
+
+class Si7021Model : public VirtualI2cDevice {
+    public:
+        Si7021Model(HumiditySensorKind kind);
+
+        // The air the sensor sits in, sampled when a conversion starts.
+        void setConditions(float humidity, float celsius);
+        // Corrupts the CRC of the next count results.
+        void injectCrcFaults(int count);
+        // A sensor that stops answering NACKs every transfer.
+        void setPresent(bool present);
+
+        uint8_t getUserRegister();
+        unsigned long getConversionCount();
+
+        uint8_t getAddress();
+        bool write(const uint8_t* data, int length, bool stop);
+        int read(uint8_t* data, int length);
+    private:
+        enum Pending { PENDING_NONE, PENDING_HUMIDITY, PENDING_TEMPERATURE, PENDING_PREVIOUS, PENDING_USER_REGISTER, PENDING_ID };
+
+        void startConversion(bool humidity, bool hold);
+        uint32_t getConversionMicros(bool humidity);
+        uint16_t humidityCode();
+        uint16_t temperatureCode();
+        static uint8_t crc8(const uint8_t* data, int length);
+
+        HumiditySensorKind _kind;
+        float _humidity;
+        float _celsius;
+        bool _present;
+        int _crcFaults;
+
+        uint8_t _userRegister;
+        Pending _pending;
+        bool _hold;
+        uint64_t _readyAt;
+        uint16_t _result;
+        uint16_t _previousTemperature;
+        unsigned long _conversions;
+};
+
+#endif
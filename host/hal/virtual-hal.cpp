@@ -0,0 +1,597 @@
+#include "virtual-hal.h"
+#include "application.h"
+
+#include <stdio.h>
+
+// ctor()
+VirtualClock::VirtualClock() {
+    reset();
+}
+
+void VirtualClock::reset() {
+    _now = 0;
+    _sourceCount = 0;
+}
+
+uint64_t VirtualClock::now() {
+    return _now;
+}
+
+void VirtualClock::advance(uint64_t micros) {
+    advanceTo(_now + micros);
+}
+
+// Moves time forward, firing every event due on the way in time order.
+void VirtualClock::advanceTo(uint64_t at) {
+    uint64_t next;
+    while ((next = nextEventAt()) <= at) {
+        if (next > _now) {
+            _now = next;
+        }
+        for (int i = 0; i < _sourceCount; i++) {
+            if (_sources[i]->nextEventAt() == next) {
+                _sources[i]->fire(_now);
+                break;
+            }
+        }
+    }
+    if (at > _now) {
+        _now = at;
+    }
+}
+
+// Time of the earliest event of any source, UINT64_MAX for none.
+uint64_t VirtualClock::nextEventAt() {
+    uint64_t next = UINT64_MAX;
+    for (int i = 0; i < _sourceCount; i++) {
+        uint64_t at = _sources[i]->nextEventAt();
+        if (at < next) {
+            next = at;
+        }
+    }
+    return next;
+}
+
+bool VirtualClock::addSource(VirtualEventSource* source) {
+    if (_sourceCount >= VIRTUAL_EVENT_SOURCES) {
+        return false;
+    }
+    _sources[_sourceCount++] = source;
+    return true;
+}
+
+void VirtualClock::removeSources() {
+    _sourceCount = 0;
+}
+
+// ctor()
+VirtualI2cDevice::VirtualI2cDevice() {
+    resetCounters();
+}
+
+void VirtualI2cDevice::recordTransfer(uint64_t busMicros) {
+    _transactions++;
+    _busMicros += busMicros;
+}
+
+unsigned long VirtualI2cDevice::getTransactionCount() {
+    return _transactions;
+}
+
+uint64_t VirtualI2cDevice::getBusMicros() {
+    return _busMicros;
+}
+
+void VirtualI2cDevice::resetCounters() {
+    _transactions = 0;
+    _busMicros = 0;
+}
+
+// the simulated world
+static VirtualClock virtualClock;
+static int analogValues[VIRTUAL_PINS];
+static int (*analogHandler)(int pin, void* context);
+static void* analogContext;
+static int digitalLevels[VIRTUAL_PINS];
+static unsigned long pulseCounts[VIRTUAL_PINS];
+static unsigned long pendingPulses[VIRTUAL_PINS];
+static std::function<void()> interruptHandlers[VIRTUAL_PINS];
+static bool interruptsEnabled;
+static VirtualI2cDevice* i2cDevices[VIRTUAL_I2C_DEVICES];
+static int i2cDeviceCount;
+static VirtualOneWireBus* oneWireBuses[VIRTUAL_PINS];
+static float fuelVCell;
+static float fuelSoC;
+static bool cloudConnected;
+static bool publishSucceeds;
+static void (*publishHandler)(const char* name, const char* data, void* context);
+static void* publishContext;
+static unsigned long publishCount;
+static unsigned long publishBytes;
+static bool timeValid;
+static bool serialEcho;
+static uint8_t eepromBytes[VIRTUAL_EEPROM_SIZE];
+
+static bool validPin(int pin) {
+    return pin >= 0 && pin < VIRTUAL_PINS;
+}
+
+void VirtualHal::reset() {
+    virtualClock.reset();
+    for (int pin = 0; pin < VIRTUAL_PINS; pin++) {
+        analogValues[pin] = 0;
+        digitalLevels[pin] = LOW;
+        pulseCounts[pin] = 0;
+        pendingPulses[pin] = 0;
+        interruptHandlers[pin] = std::function<void()>();
+        oneWireBuses[pin] = 0;
+    }
+    analogHandler = 0;
+    analogContext = 0;
+    interruptsEnabled = true;
+    i2cDeviceCount = 0;
+    fuelVCell = 4.1;
+    fuelSoC = 90;
+    cloudConnected = true;
+    publishSucceeds = true;
+    publishHandler = 0;
+    publishContext = 0;
+    publishCount = 0;
+    publishBytes = 0;
+    timeValid = true;
+    serialEcho = false;
+    // erased flash reads back as all ones
+    memset(eepromBytes, 0xFF, sizeof(eepromBytes));
+}
+
+VirtualClock& VirtualHal::clock() {
+    return virtualClock;
+}
+
+void VirtualHal::setAnalog(int pin, int value) {
+    if (validPin(pin)) {
+        analogValues[pin] = value;
+    }
+}
+
+void VirtualHal::setAnalogHandler(int (*handler)(int pin, void* context), void* context) {
+    analogHandler = handler;
+    analogContext = context;
+}
+
+void VirtualHal::setDigital(int pin, int level) {
+    if (validPin(pin)) {
+        digitalLevels[pin] = level;
+    }
+}
+
+int VirtualHal::getDigital(int pin) {
+    return validPin(pin) ? digitalLevels[pin] : LOW;
+}
+
+// An edge while interrupts are off is held until they are turned back on,
+// like the pending flag of the real interrupt controller.
+void VirtualHal::pulse(int pin) {
+    if (!validPin(pin)) {
+        return;
+    }
+    pulseCounts[pin]++;
+    if (!interruptHandlers[pin]) {
+        return;
+    }
+    if (interruptsEnabled) {
+        interruptHandlers[pin]();
+    } else {
+        pendingPulses[pin]++;
+    }
+}
+
+unsigned long VirtualHal::getPulseCount(int pin) {
+    return validPin(pin) ? pulseCounts[pin] : 0;
+}
+
+bool VirtualHal::attachI2c(VirtualI2cDevice* device) {
+    if (i2cDeviceCount >= VIRTUAL_I2C_DEVICES) {
+        return false;
+    }
+    i2cDevices[i2cDeviceCount++] = device;
+    return true;
+}
+
+VirtualI2cDevice* VirtualHal::findI2c(uint8_t address) {
+    for (int i = 0; i < i2cDeviceCount; i++) {
+        if (i2cDevices[i]->getAddress() == address) {
+            return i2cDevices[i];
+        }
+    }
+    return 0;
+}
+
+void VirtualHal::attachOneWire(int pin, VirtualOneWireBus* bus) {
+    if (validPin(pin)) {
+        oneWireBuses[pin] = bus;
+    }
+}
+
+VirtualOneWireBus* VirtualHal::findOneWire(int pin) {
+    return validPin(pin) ? oneWireBuses[pin] : 0;
+}
+
+void VirtualHal::setFuelGauge(float vcell, float soc) {
+    fuelVCell = vcell;
+    fuelSoC = soc;
+}
+
+float VirtualHal::getVCell() {
+    return fuelVCell;
+}
+
+float VirtualHal::getSoC() {
+    return fuelSoC;
+}
+
+void VirtualHal::setCloud(bool connected, bool succeeds) {
+    cloudConnected = connected;
+    publishSucceeds = succeeds;
+}
+
+bool VirtualHal::getCloudConnected() {
+    return cloudConnected;
+}
+
+bool VirtualHal::getPublishSucceeds() {
+    return publishSucceeds;
+}
+
+void VirtualHal::setPublishHandler(void (*handler)(const char* name, const char* data, void* context), void* context) {
+    publishHandler = handler;
+    publishContext = context;
+}
+
+void VirtualHal::recordPublish(const char* name, const char* data) {
+    publishCount++;
+    publishBytes += strlen(data);
+    if (publishHandler) {
+        publishHandler(name, data, publishContext);
+    }
+}
+
+unsigned long VirtualHal::getPublishCount() {
+    return publishCount;
+}
+
+unsigned long VirtualHal::getPublishBytes() {
+    return publishBytes;
+}
+
+void VirtualHal::setTimeValid(bool valid) {
+    timeValid = valid;
+}
+
+bool VirtualHal::getTimeValid() {
+    return timeValid;
+}
+
+void VirtualHal::setSerialEcho(bool echo) {
+    serialEcho = echo;
+}
+
+bool VirtualHal::getSerialEcho() {
+    return serialEcho;
+}
+
+uint8_t* VirtualHal::eeprom() {
+    return eepromBytes;
+}
+
+// Device OS API
+
+// the full 64 bit count, the 32 bit wrap of the device would come around
+// every 71 minutes of simulated time
+unsigned long millis() {
+    return virtualClock.now() / 1000;
+}
+
+unsigned long micros() {
+    return virtualClock.now();
+}
+
+void delay(unsigned long ms) {
+    virtualClock.advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    virtualClock.advance(us);
+}
+
+void pinMode(uint16_t pin, PinMode mode) {
+    if (mode == INPUT_PULLUP) {
+        VirtualHal::setDigital(pin, HIGH);
+    }
+}
+
+void digitalWrite(uint16_t pin, uint8_t value) {
+    VirtualHal::setDigital(pin, value);
+}
+
+int32_t digitalRead(uint16_t pin) {
+    return VirtualHal::getDigital(pin);
+}
+
+int32_t analogRead(uint16_t pin) {
+    if (!validPin(pin)) {
+        return 0;
+    }
+    int value = analogHandler ? analogHandler(pin, analogContext) : -1;
+    return value >= 0 ? value : analogValues[pin];
+}
+
+long map(long value, long fromStart, long fromEnd, long toStart, long toEnd) {
+    if (fromEnd == fromStart) {
+        return toStart;
+    }
+    return (value - fromStart) * (toEnd - toStart) / (fromEnd - fromStart) + toStart;
+}
+
+bool attachInterrupt(uint16_t pin, std::function<void()> handler, InterruptMode mode) {
+    if (!validPin(pin)) {
+        return false;
+    }
+    interruptHandlers[pin] = handler;
+    return true;
+}
+
+void detachInterrupt(uint16_t pin) {
+    if (validPin(pin)) {
+        interruptHandlers[pin] = std::function<void()>();
+    }
+}
+
+void noInterrupts() {
+    interruptsEnabled = false;
+}
+
+void interrupts() {
+    interruptsEnabled = true;
+    for (int pin = 0; pin < VIRTUAL_PINS; pin++) {
+        for (; pendingPulses[pin] > 0; pendingPulses[pin]--) {
+            if (interruptHandlers[pin]) {
+                interruptHandlers[pin]();
+            }
+        }
+    }
+}
+
+USBSerial Serial;
+
+void USBSerial::begin(long baud) {
+}
+
+// a key is always waiting, so the debug mode prompt doesn't block
+int USBSerial::available() {
+    return 1;
+}
+
+size_t USBSerial::write(uint8_t c) {
+    if (serialEcho) {
+        putchar(c);
+    }
+    return 1;
+}
+
+size_t USBSerial::print(const char* s) {
+    return serialEcho ? printf("%s", s) : strlen(s);
+}
+
+size_t USBSerial::print(char c) {
+    return write(c);
+}
+
+size_t USBSerial::print(int value, int base) {
+    return print((long)value, base);
+}
+
+size_t USBSerial::print(unsigned int value, int base) {
+    return print((unsigned long)value, base);
+}
+
+size_t USBSerial::print(long value, int base) {
+    if (base == HEX) {
+        return print((unsigned long)value, base);
+    }
+    char digits[24];
+    snprintf(digits, sizeof(digits), "%ld", value);
+    return print(digits);
+}
+
+size_t USBSerial::print(unsigned long value, int base) {
+    char digits[24];
+    snprintf(digits, sizeof(digits), base == HEX ? "%lX" : "%lu", value);
+    return print(digits);
+}
+
+size_t USBSerial::print(double value, int digits) {
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return print(text);
+}
+
+size_t USBSerial::println(const char* s) {
+    return print(s) + println();
+}
+
+size_t USBSerial::println() {
+    return print("\r\n");
+}
+
+TwoWire Wire;
+
+void TwoWire::begin() {
+    _clock = VIRTUAL_I2C_CLOCK;
+    _address = 0;
+    _length = 0;
+    _position = 0;
+}
+
+void TwoWire::setSpeed(uint32_t clock) {
+    _clock = clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address) {
+    _address = address;
+    _length = 0;
+}
+
+void TwoWire::beginTransmission(int address) {
+    beginTransmission((uint8_t)address);
+}
+
+size_t TwoWire::write(uint8_t data) {
+    if (_length >= (int)sizeof(_buffer)) {
+        return 0;
+    }
+    _buffer[_length++] = data;
+    return 1;
+}
+
+// 0 on success, 2 when nobody answers the address, 3 for a NACK on the data
+uint8_t TwoWire::endTransmission(uint8_t stop) {
+    VirtualI2cDevice* device = VirtualHal::findI2c(_address);
+    int length = _length;
+    _length = 0;
+    if (!device) {
+        holdBus(0, 0);
+        return 2;
+    }
+    bool acked = device->write(_buffer, length, stop);
+    holdBus(device, length);
+    return acked ? 0 : 3;
+}
+
+uint8_t TwoWire::requestFrom(int address, int quantity, int stop) {
+    VirtualI2cDevice* device = VirtualHal::findI2c(address);
+    if (quantity > (int)sizeof(_buffer)) {
+        quantity = sizeof(_buffer);
+    }
+    _length = device ? device->read(_buffer, quantity) : 0;
+    _position = 0;
+    holdBus(device, _length);
+    return _length;
+}
+
+int TwoWire::available() {
+    return _length - _position;
+}
+
+int TwoWire::read() {
+    return _position < _length ? _buffer[_position++] : -1;
+}
+
+// A start, the address and the data bytes, 9 clocks each with the
+// acknowledge, then the stop.
+void TwoWire::holdBus(VirtualI2cDevice* device, int bytes) {
+    if (_clock == 0) {
+        _clock = VIRTUAL_I2C_CLOCK;
+    }
+    uint64_t busMicros = ((1 + bytes) * 9 + 2) * 1000000ULL / _clock;
+    if (device) {
+        device->recordTransfer(busMicros);
+    }
+    virtualClock.advance(busMicros);
+}
+
+float FuelGauge::getVCell() {
+    return VirtualHal::getVCell();
+}
+
+float FuelGauge::getSoC() {
+    return VirtualHal::getSoC();
+}
+
+CloudClass Particle;
+CloudClass Spark;
+
+// the cloud sets the clock when it connects, as Device OS does
+void CloudClass::connect() {
+    if (VirtualHal::getCloudConnected()) {
+        VirtualHal::setTimeValid(true);
+    }
+}
+
+void CloudClass::disconnect() {
+}
+
+bool CloudClass::connected() {
+    return VirtualHal::getCloudConnected();
+}
+
+void CloudClass::process() {
+}
+
+bool CloudClass::publish(const char* name, const char* data, PublishFlag flag) {
+    if (!VirtualHal::getCloudConnected() || !VirtualHal::getPublishSucceeds()) {
+        return false;
+    }
+    VirtualHal::recordPublish(name, data);
+    return true;
+}
+
+CellularClass Cellular;
+
+void CellularClass::on() {
+}
+
+void CellularClass::off() {
+}
+
+TimeClass Time;
+
+// until the cloud sets it the RTC counts from power up, like on the device
+uint32_t TimeClass::now() {
+    if (!VirtualHal::getTimeValid()) {
+        return virtualClock.now() / 1000000;
+    }
+    return VIRTUAL_EPOCH + virtualClock.now() / 1000000;
+}
+
+bool TimeClass::isValid() {
+    return VirtualHal::getTimeValid();
+}
+
+SystemClass System;
+
+void SystemClass::enableFeature(int feature) {
+}
+
+void SystemClass::sleep(uint16_t wakeUpPin, InterruptMode edge, long seconds) {
+    uint64_t wakeAt = virtualClock.now() + (uint64_t)seconds * 1000000;
+    unsigned long pulses = VirtualHal::getPulseCount(wakeUpPin);
+
+    _wokenUpByPin = false;
+    while (virtualClock.now() < wakeAt) {
+        uint64_t next = virtualClock.nextEventAt();
+        virtualClock.advanceTo(next < wakeAt ? next : wakeAt);
+        if (VirtualHal::getPulseCount(wakeUpPin) != pulses) {
+            _wokenUpByPin = true;
+            break;
+        }
+    }
+}
+
+bool SystemClass::wokenUpByPin() {
+    return _wokenUpByPin;
+}
+
+EEPROMClass EEPROM;
+
+uint8_t EEPROMClass::read(int address) {
+    return eepromBytes[address];
+}
+
+void EEPROMClass::write(int address, uint8_t value) {
+    eepromBytes[address] = value;
+}
+
+uint16_t EEPROMClass::length() {
+    return VIRTUAL_EEPROM_SIZE;
+}
@@ -0,0 +1,135 @@
+// Linux backend for the firmware's hardware calls.
+//
+// host/hal takes the place of the Particle Device OS headers when the
+// firmware is built with g++ on a workstation: put it first on the include
+// path (-Ihost/hal) and src/ compiles unchanged against it. The device build
+// never sees these files, so the abstraction costs nothing there.
+//
+// Time is virtual. millis(), micros() and delay() read and advance a
+// VirtualClock instead of the wall clock, so a 5 second sampling window
+// runs in microseconds and every run gives the same timings. Pins, I2C
+// devices, the 1-Wire bus, the fuel gauge and the cloud are simulated and
+// driven through VirtualHal.
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef VirtualHal_h
+#define VirtualHal_h
+
+#define VIRTUAL_PINS 24
+#define VIRTUAL_EVENT_SOURCES 8
+#define VIRTUAL_I2C_DEVICES 8
+#define VIRTUAL_I2C_CLOCK 100000 // Hz, the Wire default
+#define VIRTUAL_EEPROM_SIZE 2047 // emulated EEPROM on the Photon and Electron
+#define VIRTUAL_EPOCH 1700000000 // Time.now() at power up, once the clock is set
+
+// Something that happens at a point in virtual time, like a pulse from a
+// trace. The clock asks for the next event and fires it once time gets there.
+class VirtualEventSource {
+    public:
+        virtual ~VirtualEventSource() {}
+
+        // Virtual time in us of the next event, or UINT64_MAX for none.
+        virtual uint64_t nextEventAt() = 0;
+        virtual void fire(uint64_t now) = 0;
+};
+
+// Virtual time in microseconds since the simulated power up.
+class VirtualClock {
+    public:
+        VirtualClock();
+
+        void reset();
+        uint64_t now();
+        void advance(uint64_t micros);
+        void advanceTo(uint64_t at);
+        uint64_t nextEventAt();
+
+        bool addSource(VirtualEventSource* source);
+        void removeSources();
+    private:
+        uint64_t _now;
+        VirtualEventSource* _sources[VIRTUAL_EVENT_SOURCES];
+        int _sourceCount;
+};
+
+// A device on the simulated I2C bus. Transfers arrive whole: the bytes of
+// one write transmission, or a read request for a number of bytes. The bus
+// counts every transfer addressed to the device and the time it held the
+// bus, which also moves the virtual clock on.
+class VirtualI2cDevice {
+    public:
+        VirtualI2cDevice();
+        virtual ~VirtualI2cDevice() {}
+
+        virtual uint8_t getAddress() = 0;
+        // Returns false to NACK the transmission.
+        virtual bool write(const uint8_t* data, int length, bool stop) = 0;
+        // Returns how many of the requested bytes were sent, 0 for a NACK
+        // (a conversion still running, for example).
+        virtual int read(uint8_t* data, int length) = 0;
+
+        void recordTransfer(uint64_t busMicros);
+        unsigned long getTransactionCount();
+        uint64_t getBusMicros();
+        void resetCounters();
+    private:
+        unsigned long _transactions;
+        uint64_t _busMicros;
+};
+
+// The devices on a simulated 1-Wire bus, driven one time slot at a time.
+class VirtualOneWireBus {
+    public:
+        virtual ~VirtualOneWireBus() {}
+
+        // Returns true if a device answered with a presence pulse.
+        virtual bool reset() = 0;
+        virtual void writeBit(uint8_t bit) = 0;
+        // The wired-AND of what every device puts on the bus, 1 when idle.
+        virtual uint8_t readBit() = 0;
+};
+
+// Controls the simulated world the firmware runs in.
+class VirtualHal {
+    public:
+        // Back to power up: time 0, pins low, nothing attached.
+        static void reset();
+        static VirtualClock& clock();
+
+        static void setAnalog(int pin, int value);
+        // Asked first on every analogRead(), -1 falls back to setAnalog().
+        static void setAnalogHandler(int (*handler)(int pin, void* context), void* context);
+        static void setDigital(int pin, int level);
+        static int getDigital(int pin);
+        // A falling edge on the pin, runs its interrupt handler.
+        static void pulse(int pin);
+        static unsigned long getPulseCount(int pin);
+
+        static bool attachI2c(VirtualI2cDevice* device);
+        static VirtualI2cDevice* findI2c(uint8_t address);
+        static void attachOneWire(int pin, VirtualOneWireBus* bus);
+        static VirtualOneWireBus* findOneWire(int pin);
+
+        static void setFuelGauge(float vcell, float soc);
+        static float getVCell();
+        static float getSoC();
+
+        static void setCloud(bool connected, bool publishSucceeds);
+        static bool getCloudConnected();
+        static bool getPublishSucceeds();
+        static void setPublishHandler(void (*handler)(const char* name, const char* data, void* context), void* context);
+        static void recordPublish(const char* name, const char* data);
+        static unsigned long getPublishCount();
+        static unsigned long getPublishBytes();
+
+        static void setTimeValid(bool valid);
+        static bool getTimeValid();
+        static void setSerialEcho(bool echo);
+        static bool getSerialEcho();
+
+        static uint8_t* eeprom();
+};
+
+#endif
@@ -0,0 +1,58 @@
+// A synthetic day of telemetry records for the host tools: a daily
+// temperature swing, a shower in the afternoon and a few failed sensors.
+
+#include "telemetry-record.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifndef SyntheticDay_h
+#define SyntheticDay_h
+
+#define CYCLE_SECONDS (15*60)
+#define READINGS_PER_DAY (24*60*60 / CYCLE_SECONDS)
+
+static inline TelemetryRecord makeRecord(int i) {
+    TelemetryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.sequence = 1000 + i;
+    record.timestamp = 1700000000 + i * CYCLE_SECONDS + (i % 3); // wakes drift by a second or two
+    record.tempF = 550 + lround(120 * sin(i * 2 * M_PI / READINGS_PER_DAY));
+    record.humidity = 700 - lround(200 * sin(i * 2 * M_PI / READINGS_PER_DAY));
+    record.pressure = 29920 + (i % 17) - 8;
+    record.pressureTendency = (i % 5) - 2;
+    record.soilTempF = 520 + lround(30 * sin(i * 2 * M_PI / READINGS_PER_DAY));
+    record.soilProbeCount = 3;
+    for (int probe = 0; probe < 3; probe++) {
+        record.soilProbeTempsF[probe] = record.soilTempF - probe * 15;
+    }
+    record.soilMoisture = 40 + i / 20;
+    record.windMPH = (i * 37) % 180;
+    record.gustMPH = record.windMPH + (i * 13) % 60;
+    record.windDegrees = (i * 450) % 3600;
+    record.rainTips = (i > 40 && i < 50) ? i % 7 : 0;
+    record.rainHourTips = record.rainTips * 4;
+    record.rainDayTips = i > 40 ? 25 : 0;
+    record.rainPeakIntensity = record.rainTips * 53;
+    record.vcell = 4100 - i;
+    record.soc = 90 - i / 10;
+    record.interval = record.rainTips ? 300 : CYCLE_SECONDS;
+    record.intervalReason = record.rainTips ? 3 : 0;
+    record.hoursToEmpty = i == 0 ? TELEMETRY_MISSING_U16 : 1400 - i / 4; // unknown until a cycle is recorded
+    record.powerTier = 0;
+
+    // a few failed sensors
+    if (i % 31 == 7) {
+        record.tempF = TELEMETRY_MISSING_I16;
+        record.humidity = TELEMETRY_MISSING_U16;
+    }
+    if (i % 23 == 5) {
+        record.soilProbeTempsF[1] = TELEMETRY_MISSING_I16;
+    }
+    if (i == 0) {
+        record.pressureTendency = TELEMETRY_MISSING_I16;
+    }
+    return record;
+}
+
+#endif
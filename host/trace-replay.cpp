@@ -0,0 +1,660 @@
+// Replays a recorded sensor trace through the whole acquisition cycle.
+//
+// A trace is the debug output of a station running with
+// weatherService.init(true, true), captured with `npm run monitor`. Only
+// the lines starting with @ are read, everything else is skipped:
+//
+//   @c <unix> <millis> <micros>      a cycle starts, the clocks at its start
+//   @b <vcell> <soc>                 fuel gauge
+//   @v <raw>                         wind vane ADC, one per sample
+//   @a <micros>                      anemometer pulse
+//   @r <unix>                        rain gauge tip
+//   @h <humidity> <celsius>          Si7021 reading, or @h crc / @h timeout
+//   @p <millis> <pascals> <celsius>  MPL3115A2 sample, or @p timeout
+//   @m <raw>                         soil moisture ADC
+//   @s <rom> <celsius>               soil probe reading, or @s <rom> fail
+//
+// WeatherService runs against the host/hal sensor models, which play the
+// trace back under the virtual clock: pulses and pressure samples at the
+// time they happened, everything else as the conditions of its cycle, and
+// the vane ADC sample by sample. The firmware runs the loop() passes the
+// device does, runOnce() and sleep(), but each cycle starts when the
+// recorded one did, so the readings stay comparable whatever the firmware
+// decides about its sleep interval. The replay is deterministic, the same
+// firmware gives the same report on every run and every machine.
+//
+// For every cycle the report shows the simulated awake time, the energy of
+// the cycle at the power governor's current draws (awake time plus the
+// sleep the firmware chose), the bytes logged and published, and the
+// reading. The report is compared against a stored baseline, and a cycle
+// that stays awake or spends more than 1% longer, logs or publishes more
+// bytes, or computes a different reading is flagged and fails the run.
+//
+//   npm run -s replay:trace -- <trace> [--baseline <file>] [--update]
+//
+// The baseline defaults to the trace's name with .baseline in place of
+// .trace, --update writes it from this run. Cycles recorded before the
+// cloud set the clock are stamped from power up and can't be placed next
+// to the rest, they're skipped.
+
+#include "application.h"
+#include "weather-service.h"
+#include "si7021-model.h"
+#include "mpl3115a2-model.h"
+#include "one-wire-models.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#define ANEMOMETER_PIN D3
+#define RAIN_GAUGE_PIN D2
+#define SOIL_PROBE_PIN D4
+#define WIND_VANE_PIN A0
+#define SOIL_MOISTURE_PIN A1
+
+// a cycle regresses when it stays awake or spends this much longer
+#define AWAKE_TOLERANCE 0.01
+#define ENERGY_TOLERANCE 0.01
+
+// the unset clock counts from power up, it never gets this far (2000-01-01)
+#define CLOCK_SET_AFTER 946684800
+
+enum HumidityStatus { HUMIDITY_NONE, HUMIDITY_OK, HUMIDITY_CRC, HUMIDITY_TIMEOUT };
+
+struct ProbeReading {
+    uint8_t rom[8];
+    bool ok;
+    float celsius;
+};
+
+struct TraceCycle {
+    uint64_t at; // virtual time the cycle starts
+    uint32_t unixTime;
+    uint32_t millisAt;
+    uint32_t microsAt;
+    bool battery;
+    float vcell;
+    float soc;
+    std::vector<int> vane;
+    int moisture;
+    HumidityStatus humidity;
+    float relativeHumidity;
+    float celsius;
+    bool pressureTimeout;
+    std::vector<ProbeReading> probes;
+};
+
+struct PressurePoint {
+    uint64_t at;
+    float pascals;
+    float celsius;
+};
+
+struct Trace {
+    std::vector<TraceCycle> cycles;
+    std::vector<uint64_t> anemometer;
+    std::vector<uint64_t> rain;
+    std::vector<PressurePoint> pressure;
+};
+
+// What one replayed cycle came to, also the line format of the baseline.
+struct CycleResult {
+    uint64_t awakeMicros;
+    float mah;
+    unsigned long recordBytes;
+    unsigned long publishedBytes;
+    std::string reading;
+};
+
+// A recorded time relative to the clock at the start of its cycle, times
+// before the first cycle are played at its start.
+static uint64_t offsetFrom(uint64_t at, int64_t micros) {
+    return micros < 0 && (uint64_t)-micros > at ? 0 : at + micros;
+}
+
+static bool parseRom(const char* hex, uint8_t rom[8]) {
+    for (int i = 0; i < 8; i++) {
+        unsigned int value;
+        if (sscanf(hex + i * 2, "%2x", &value) != 1) {
+            return false;
+        }
+        rom[i] = value;
+    }
+    return true;
+}
+
+static bool loadTrace(const char* path, Trace* trace) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    char line[256];
+    uint32_t firstUnix = 0;
+    bool unset = false;
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] != '@') {
+            continue;
+        }
+        const char* args = line + 2;
+        while (*args == ' ') {
+            args++;
+        }
+
+        if (line[1] == 'c') {
+            TraceCycle cycle = TraceCycle();
+            unsigned long unixTime, millisAt, microsAt;
+            if (sscanf(args, "%lu %lu %lu", &unixTime, &millisAt, &microsAt) != 3) {
+                continue;
+            }
+            unset = unixTime < CLOCK_SET_AFTER;
+            if (unset) {
+                continue;
+            }
+            if (trace->cycles.empty()) {
+                firstUnix = unixTime;
+            }
+            cycle.unixTime = unixTime;
+            cycle.millisAt = millisAt;
+            cycle.microsAt = microsAt;
+            cycle.at = (uint64_t)(unixTime - firstUnix) * 1000000;
+            cycle.moisture = -1;
+            trace->cycles.push_back(cycle);
+            continue;
+        }
+        // everything else belongs to the cycle it was recorded in
+        if (unset || trace->cycles.empty()) {
+            continue;
+        }
+        TraceCycle& cycle = trace->cycles.back();
+
+        switch (line[1]) {
+            case 'b':
+                cycle.battery = sscanf(args, "%f %f", &cycle.vcell, &cycle.soc) == 2;
+                break;
+            case 'v': {
+                int raw;
+                if (sscanf(args, "%d", &raw) == 1) {
+                    cycle.vane.push_back(raw);
+                }
+                break;
+            }
+            case 'a': {
+                unsigned long micros;
+                if (sscanf(args, "%lu", &micros) == 1) {
+                    // micros() wraps every 71 minutes, the difference doesn't
+                    trace->anemometer.push_back(offsetFrom(cycle.at, (int32_t)((uint32_t)micros - cycle.microsAt)));
+                }
+                break;
+            }
+            case 'r': {
+                unsigned long unixTime;
+                if (sscanf(args, "%lu", &unixTime) == 1) {
+                    // the tip is only known to the second, play it in the middle
+                    trace->rain.push_back(offsetFrom(cycle.at, ((int64_t)unixTime - cycle.unixTime) * 1000000 + 500000));
+                }
+                break;
+            }
+            case 'h':
+                if (strncmp(args, "crc", 3) == 0) {
+                    cycle.humidity = HUMIDITY_CRC;
+                } else if (strncmp(args, "timeout", 7) == 0) {
+                    cycle.humidity = HUMIDITY_TIMEOUT;
+                } else if (sscanf(args, "%f %f", &cycle.relativeHumidity, &cycle.celsius) == 2) {
+                    cycle.humidity = HUMIDITY_OK;
+                }
+                break;
+            case 'p': {
+                unsigned long millisAt;
+                PressurePoint point;
+                if (strncmp(args, "timeout", 7) == 0) {
+                    cycle.pressureTimeout = true;
+                } else if (sscanf(args, "%lu %f %f", &millisAt, &point.pascals, &point.celsius) == 3) {
+                    point.at = offsetFrom(cycle.at, (int64_t)(int32_t)((uint32_t)millisAt - cycle.millisAt) * 1000);
+                    trace->pressure.push_back(point);
+                }
+                break;
+            }
+            case 'm':
+                sscanf(args, "%d", &cycle.moisture);
+                break;
+            case 's': {
+                char rom[17];
+                char value[16];
+                ProbeReading probe;
+                if (sscanf(args, "%16s %15s", rom, value) != 2 || !parseRom(rom, probe.rom)) {
+                    break;
+                }
+                probe.ok = strcmp(value, "fail") != 0;
+                probe.celsius = probe.ok ? atof(value) : 0;
+                cycle.probes.push_back(probe);
+                break;
+            }
+        }
+    }
+    fclose(file);
+
+    std::sort(trace->anemometer.begin(), trace->anemometer.end());
+    std::sort(trace->rain.begin(), trace->rain.end());
+    std::stable_sort(trace->pressure.begin(), trace->pressure.end(),
+        [](const PressurePoint& a, const PressurePoint& b) { return a.at < b.at; });
+    return true;
+}
+
+// Pulses on a pin at recorded times.
+class TracePulses : public VirtualEventSource {
+    public:
+        TracePulses(int pin, const std::vector<uint64_t>& times) : _times(times) {
+            _pin = pin;
+            _next = 0;
+        }
+
+        uint64_t nextEventAt() {
+            return _next < _times.size() ? _times[_next] : UINT64_MAX;
+        }
+
+        void fire(uint64_t now) {
+            VirtualHal::pulse(_pin);
+            _next++;
+        }
+    private:
+        int _pin;
+        const std::vector<uint64_t>& _times;
+        size_t _next;
+};
+
+// The barometer samples whatever the trace recorded closest to the time.
+// FIFO samples are traced at times counted back from the drain, which can
+// land a little after the conversion they came from.
+class TraceBarometer : public Mpl3115a2Model {
+    public:
+        TraceBarometer(const std::vector<PressurePoint>& points) : _points(points) {
+        }
+    protected:
+        void getConditions(uint64_t at, float* pascals, float* celsius) {
+            if (_points.empty()) {
+                Mpl3115a2Model::getConditions(at, pascals, celsius);
+                return;
+            }
+            size_t i = 0;
+            while (i + 1 < _points.size() && _points[i + 1].at <= at) {
+                i++;
+            }
+            if (i + 1 < _points.size() && _points[i + 1].at - at < at - _points[i].at) {
+                i++;
+            }
+            *pascals = _points[i].pascals;
+            *celsius = _points[i].celsius;
+        }
+    private:
+        const std::vector<PressurePoint>& _points;
+};
+
+// Hands the firmware the recorded vane samples in order, the last one
+// again if it takes more, and the cycle's soil moisture.
+struct AnalogPlayback {
+    const TraceCycle* cycle;
+    size_t vaneSample;
+};
+
+static int playAnalog(int pin, void* context) {
+    AnalogPlayback* playback = (AnalogPlayback*)context;
+    const TraceCycle* cycle = playback->cycle;
+    if (!cycle) {
+        return -1;
+    }
+    if (pin == WIND_VANE_PIN && !cycle->vane.empty()) {
+        size_t sample = std::min(playback->vaneSample++, cycle->vane.size() - 1);
+        return cycle->vane[sample];
+    }
+    if (pin == SOIL_MOISTURE_PIN) {
+        return cycle->moisture;
+    }
+    return -1;
+}
+
+static unsigned long publishedBytes;
+
+static void countPublish(const char* name, const char* data, void* context) {
+    publishedBytes += strlen(data);
+}
+
+// The reading without its sequence number and timestamp, which say nothing
+// about the values.
+static std::string readingOf(const char* json) {
+    std::string reading;
+    const char* p = json;
+    while ((p = strchr(p, '"')) != NULL) {
+        const char* keyEnd = strchr(p + 1, '"');
+        if (!keyEnd || keyEnd[1] != ':') {
+            break;
+        }
+        std::string key(p + 1, keyEnd - p - 1);
+        const char* value = keyEnd + 2;
+        const char* end = value;
+        int depth = 0;
+        while (*end && (depth > 0 || (*end != ',' && *end != '}'))) {
+            depth += *end == '[' ? 1 : (*end == ']' ? -1 : 0);
+            end++;
+        }
+        if (key != "n" && key != "ts") {
+            if (!reading.empty()) {
+                reading += ' ';
+            }
+            reading += key + "=" + std::string(value, end - value);
+        }
+        p = end;
+    }
+    return reading;
+}
+
+static bool loadBaseline(const char* path, std::vector<CycleResult>* results) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        CycleResult result;
+        unsigned long long awake;
+        int readingAt = 0;
+        if (sscanf(line, "%*d %llu %f %lu %lu %n", &awake, &result.mah, &result.recordBytes, &result.publishedBytes, &readingAt) < 4) {
+            continue;
+        }
+        result.awakeMicros = awake;
+        result.reading = std::string(line + readingAt);
+        while (!result.reading.empty() && (result.reading.back() == '\n' || result.reading.back() == '\r')) {
+            result.reading.pop_back();
+        }
+        results->push_back(result);
+    }
+    fclose(file);
+    return true;
+}
+
+static bool saveBaseline(const char* path, const std::vector<CycleResult>& results) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(file, "%zu %llu %.5f %lu %lu %s\n", i, (unsigned long long)results[i].awakeMicros, results[i].mah,
+            results[i].recordBytes, results[i].publishedBytes, results[i].reading.c_str());
+    }
+    fclose(file);
+    return true;
+}
+
+// The values of the reading that differ from the baseline's, key by key.
+static std::string readingChanges(const std::string& reading, const std::string& baseline) {
+    std::vector<std::string> now, before;
+    char* copy = strdup(reading.c_str());
+    for (char* field = strtok(copy, " "); field; field = strtok(NULL, " ")) {
+        now.push_back(field);
+    }
+    free(copy);
+    copy = strdup(baseline.c_str());
+    for (char* field = strtok(copy, " "); field; field = strtok(NULL, " ")) {
+        before.push_back(field);
+    }
+    free(copy);
+
+    std::string changes;
+    for (size_t i = 0; i < before.size(); i++) {
+        std::string key = before[i].substr(0, before[i].find('=') + 1);
+        std::string after = "-";
+        for (size_t j = 0; j < now.size(); j++) {
+            if (now[j].compare(0, key.size(), key) == 0) {
+                after = now[j].substr(key.size());
+            }
+        }
+        if (before[i].substr(key.size()) != after) {
+            changes += " " + key + before[i].substr(key.size()) + "->" + after;
+        }
+    }
+    for (size_t j = 0; j < now.size(); j++) {
+        std::string key = now[j].substr(0, now[j].find('=') + 1);
+        bool known = false;
+        for (size_t i = 0; i < before.size(); i++) {
+            known |= before[i].compare(0, key.size(), key) == 0;
+        }
+        if (!known) {
+            changes += " " + key + "-->" + now[j].substr(key.size());
+        }
+    }
+    return changes;
+}
+
+int main(int argc, char** argv) {
+    const char* tracePath = NULL;
+    std::string baselinePath;
+    bool update = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else {
+            tracePath = argv[i];
+        }
+    }
+    if (!tracePath) {
+        fprintf(stderr, "usage: trace-replay <trace> [--baseline <file>] [--update]\n");
+        return 2;
+    }
+    if (baselinePath.empty()) {
+        baselinePath = tracePath;
+        size_t dot = baselinePath.rfind(".trace");
+        if (dot != std::string::npos) {
+            baselinePath.erase(dot);
+        }
+        baselinePath += ".baseline";
+    }
+
+    Trace trace;
+    if (!loadTrace(tracePath, &trace) || trace.cycles.empty()) {
+        fprintf(stderr, "no cycles in %s\n", tracePath);
+        return 2;
+    }
+
+    VirtualHal::reset();
+    AnalogPlayback playback = { NULL, 0 };
+    VirtualHal::setAnalogHandler(playAnalog, &playback);
+    VirtualHal::setPublishHandler(countPublish, NULL);
+
+    TracePulses wind(ANEMOMETER_PIN, trace.anemometer);
+    VirtualHal::clock().addSource(&wind);
+    TracePulses rain(RAIN_GAUGE_PIN, trace.rain);
+    VirtualHal::clock().addSource(&rain);
+
+    Si7021Model humidity(HUMIDITY_SI7021);
+    VirtualHal::attachI2c(&humidity);
+    TraceBarometer barometer(trace.pressure);
+    VirtualHal::attachI2c(&barometer);
+    VirtualHal::clock().addSource(&barometer);
+
+    // a model for every probe the trace has seen, by its ROM
+    std::vector<OneWireDeviceModel*> probes;
+    OneWireModelBus soilBus;
+    for (size_t c = 0; c < trace.cycles.size(); c++) {
+        for (size_t p = 0; p < trace.cycles[c].probes.size(); p++) {
+            const uint8_t* rom = trace.cycles[c].probes[p].rom;
+            bool known = false;
+            for (size_t i = 0; i < probes.size(); i++) {
+                known |= memcmp(probes[i]->getRom(), rom, 8) == 0;
+            }
+            if (known) {
+                continue;
+            }
+            uint64_t serial = 0;
+            for (int i = 6; i >= 1; i--) {
+                serial = (serial << 8) | rom[i];
+            }
+            OneWireDeviceModel* probe;
+            if (rom[0] == FAMILY_DS2438) {
+                probe = new Ds2438Model(serial);
+            } else {
+                probe = new Ds18x20Model(rom[0], serial);
+            }
+            if (!soilBus.attach(probe)) {
+                delete probe;
+                continue;
+            }
+            probes.push_back(probe);
+        }
+    }
+    VirtualHal::attachOneWire(SOIL_PROBE_PIN, &soilBus);
+
+    WeatherService weatherService;
+    weatherService.init(false);
+    weatherService.setSleepBounds(MIN_SECONDS_TO_SLEEP, MINUTES_TO_SLEEP, MAX_SECONDS_TO_SLEEP);
+
+    // the same draws the firmware estimates its own energy with
+    PowerTier tier = { "replay", 0, 0, 1, 0, 0, true };
+    PowerState powerState = PowerState();
+    PowerGovernor power;
+    power.init(&powerState, &tier, 1);
+
+    std::vector<CycleResult> results;
+    printf("cycle  awake (ms)  energy (mAh)  logged  published  reading\n");
+    for (size_t c = 0; c < trace.cycles.size(); c++) {
+        const TraceCycle& cycle = trace.cycles[c];
+
+        // sleep as loop() does until the recorded cycle started, rain tips
+        // wake the firmware on the way
+        while (VirtualHal::clock().now() + 1000000 <= cycle.at) {
+            weatherService.sleep((cycle.at - VirtualHal::clock().now()) / 1000000);
+        }
+        if (VirtualHal::clock().now() < cycle.at) {
+            VirtualHal::clock().advanceTo(cycle.at);
+        }
+
+        // the conditions the recorded cycle saw
+        if (cycle.battery) {
+            VirtualHal::setFuelGauge(cycle.vcell, cycle.soc);
+        }
+        playback.cycle = &cycle;
+        playback.vaneSample = 0;
+        if (cycle.humidity == HUMIDITY_OK) {
+            humidity.setConditions(cycle.relativeHumidity, cycle.celsius);
+        }
+        humidity.setPresent(cycle.humidity != HUMIDITY_TIMEOUT);
+        humidity.injectCrcFaults(cycle.humidity == HUMIDITY_CRC ? MEASUREMENT_RETRIES + 1 : 0);
+        barometer.setPresent(!cycle.pressureTimeout);
+        for (size_t p = 0; p < cycle.probes.size(); p++) {
+            for (size_t i = 0; i < probes.size(); i++) {
+                if (memcmp(probes[i]->getRom(), cycle.probes[p].rom, 8) != 0) {
+                    continue;
+                }
+                probes[i]->setPresent(cycle.probes[p].ok);
+                if (probes[i]->getRom()[0] == FAMILY_DS2438) {
+                    ((Ds2438Model*)probes[i])->setTemperature(cycle.probes[p].celsius);
+                } else {
+                    ((Ds18x20Model*)probes[i])->setTemperature(cycle.probes[p].celsius);
+                }
+            }
+        }
+
+        // the cycle is due now whatever the firmware scheduled, then it runs
+        // as loop() runs it
+        weatherService.setNextCycleAt(Time.now());
+        uint64_t start = VirtualHal::clock().now();
+        unsigned long published = publishedBytes;
+        LoopPass pass = weatherService.runOnce();
+        CycleResult result;
+        result.recordBytes = strlen(pass.reading);
+        result.reading = readingOf(pass.reading);
+        result.awakeMicros = VirtualHal::clock().now() - start;
+        result.publishedBytes = publishedBytes - published;
+
+        unsigned long awakeMs = result.awakeMicros / 1000;
+        power.recordCycle(awakeMs, pass.connected ? awakeMs : 0, pass.sleepSeconds);
+        result.mah = power.getLastCycleMah();
+        results.push_back(result);
+
+        printf("%5zu  %10.1f  %12.4f  %6lu  %9lu  %s\n", c, result.awakeMicros / 1000.0, result.mah,
+            result.recordBytes, result.publishedBytes, result.reading.c_str());
+    }
+    playback.cycle = NULL;
+
+    uint64_t totalAwake = 0;
+    double totalMah = 0;
+    unsigned long totalBytes = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        totalAwake += results[i].awakeMicros;
+        totalMah += results[i].mah;
+        totalBytes += results[i].publishedBytes;
+    }
+    printf("\n%zu cycles, %.1f s awake, %.3f mAh, %lu bytes published\n", results.size(), totalAwake / 1e6, totalMah, totalBytes);
+
+    if (update) {
+        if (!saveBaseline(baselinePath.c_str(), results)) {
+            fprintf(stderr, "can't write %s\n", baselinePath.c_str());
+            return 2;
+        }
+        printf("baseline written to %s\n", baselinePath.c_str());
+        return 0;
+    }
+
+    std::vector<CycleResult> baseline;
+    if (!loadBaseline(baselinePath.c_str(), &baseline)) {
+        printf("no baseline at %s, run with --update to store this one\n", baselinePath.c_str());
+        return 0;
+    }
+
+    uint64_t baselineAwake = 0;
+    double baselineMah = 0;
+    unsigned long baselineBytes = 0;
+    for (size_t i = 0; i < baseline.size(); i++) {
+        baselineAwake += baseline[i].awakeMicros;
+        baselineMah += baseline[i].mah;
+        baselineBytes += baseline[i].publishedBytes;
+    }
+    printf("baseline: %zu cycles, %.1f s awake, %.3f mAh, %lu bytes published\n",
+        baseline.size(), baselineAwake / 1e6, baselineMah, baselineBytes);
+
+    int regressions = 0;
+    if (baseline.size() != results.size()) {
+        printf("REGRESSION: %zu cycles replayed, the baseline has %zu\n", results.size(), baseline.size());
+        regressions++;
+    }
+    for (size_t i = 0; i < results.size() && i < baseline.size(); i++) {
+        const CycleResult& now = results[i];
+        const CycleResult& before = baseline[i];
+        std::string problems;
+        char text[96];
+        if (now.awakeMicros > before.awakeMicros * (1 + AWAKE_TOLERANCE)) {
+            snprintf(text, sizeof(text), " awake %.1f->%.1f ms", before.awakeMicros / 1000.0, now.awakeMicros / 1000.0);
+            problems += text;
+        }
+        if (now.mah > before.mah * (1 + ENERGY_TOLERANCE)) {
+            snprintf(text, sizeof(text), " energy %.4f->%.4f mAh", before.mah, now.mah);
+            problems += text;
+        }
+        if (now.recordBytes > before.recordBytes) {
+            snprintf(text, sizeof(text), " logged %lu->%lu bytes", before.recordBytes, now.recordBytes);
+            problems += text;
+        }
+        if (now.publishedBytes > before.publishedBytes) {
+            snprintf(text, sizeof(text), " published %lu->%lu bytes", before.publishedBytes, now.publishedBytes);
+            problems += text;
+        }
+        if (now.reading != before.reading) {
+            problems += readingChanges(now.reading, before.reading);
+        }
+        if (!problems.empty()) {
+            printf("REGRESSION cycle %zu:%s\n", i, problems.c_str());
+            regressions++;
+        }
+    }
+
+    if (regressions > 0) {
+        printf("%d regressions against %s\n", regressions, baselinePath.c_str());
+        return 1;
+    }
+    printf("no regressions against %s\n", baselinePath.c_str());
+    return 0;
+}
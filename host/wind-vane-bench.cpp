@@ -0,0 +1,136 @@
+// Host benchmark for the wind vane decoder.
+//
+// Compares the per-sample cost of WindVaneDecoder against the original
+// range-comparison lookup followed by cos()/sin(), and checks both agree on
+// every 12-bit ADC value. Build and run with `npm run bench:windvane`.
+
+#include "wind-vane-decoder.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// WeatherService::lookupRadiansFromRaw as it was before the decoder
+static float legacyLookupRadiansFromRaw(unsigned int analogRaw)
+{
+    if(analogRaw >= 2200 && analogRaw < 2400) return (3.14);//South
+    if(analogRaw >= 2100 && analogRaw < 2200) return (3.53);//SSW
+    if(analogRaw >= 3200 && analogRaw < 3299) return (3.93);//SW
+    if(analogRaw >= 3100 && analogRaw < 3200) return (4.32);//WSW
+    if(analogRaw >= 3890 && analogRaw < 3999) return (4.71);//West
+    if(analogRaw >= 3700 && analogRaw < 3780) return (5.11);//WNW
+    if(analogRaw >= 3780 && analogRaw < 3890) return (5.50);//NW
+    if(analogRaw >= 3400 && analogRaw < 3500) return (5.89);//NNW
+    if(analogRaw >= 3570 && analogRaw < 3700) return (0.00);//North
+    if(analogRaw >= 2600 && analogRaw < 2700) return (0.39);//NNE
+    if(analogRaw >= 2750 && analogRaw < 2850) return (0.79);//NE
+    if(analogRaw >= 1510 && analogRaw < 1580) return (1.18);//ENE
+    if(analogRaw >= 1580 && analogRaw < 1650) return (1.57);//East
+    if(analogRaw >= 1470 && analogRaw < 1510) return (1.96);//ESE
+    if(analogRaw >= 1900 && analogRaw < 2000) return (2.36);//SE
+    if(analogRaw >= 1700 && analogRaw < 1750) return (2.74);//SSE
+    if(analogRaw > 4000) return(-1); // Open circuit?  Probably means the sensor is not connected
+    return -1;
+}
+
+static int checkAgreement() {
+    int mismatches = 0;
+    for (unsigned int raw = 0; raw < 4096; raw++) {
+        float radians = legacyLookupRadiansFromRaw(raw);
+        int sector = WindVaneDecoder::sectorFromRaw(raw);
+
+        bool legacyValid = radians >= 0;
+        bool decoderValid = sector != WIND_VANE_NO_SECTOR;
+        if (legacyValid != decoderValid ||
+            (decoderValid && fabsf(WindVaneDecoder::sectorDegrees(sector) - radians * 180.0 / M_PI) > 1.0)) {
+            printf("mismatch at %u: legacy %.2f rad, decoder sector %d\n", raw, radians, sector);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+struct BenchResult {
+    double legacyNs;
+    double decoderNs;
+};
+
+static BenchResult runBench(const unsigned int* raw, int samples, int rounds) {
+    volatile float sink;
+    float cosTotal = 0;
+    float sinTotal = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < samples; i++) {
+            float radians = legacyLookupRadiansFromRaw(raw[i]);
+            if (radians >= 0) {
+                cosTotal += cosf(radians);
+                sinTotal += sinf(radians);
+            }
+        }
+    }
+    sink = cosTotal + sinTotal;
+    double legacyNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    cosTotal = 0;
+    sinTotal = 0;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < samples; i++) {
+            int sector = WindVaneDecoder::sectorFromRaw(raw[i]);
+            if (sector != WIND_VANE_NO_SECTOR) {
+                cosTotal += WindVaneDecoder::sectorCos(sector);
+                sinTotal += WindVaneDecoder::sectorSin(sector);
+            }
+        }
+    }
+    sink = cosTotal + sinTotal;
+    double decoderNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    (void)sink;
+
+    BenchResult result;
+    result.legacyNs = legacyNs / ((double)samples * rounds);
+    result.decoderNs = decoderNs / ((double)samples * rounds);
+    return result;
+}
+
+static void printResult(const char* name, BenchResult result) {
+    printf("%-22s legacy %6.2f ns/sample, decoder %6.2f ns/sample, speedup %.1fx\n",
+        name, result.legacyNs, result.decoderNs, result.legacyNs / result.decoderNs);
+}
+
+int main() {
+    const int SAMPLES = 1 << 16;
+    const int ROUNDS = 200;
+
+    // ADC value in the middle of each sector's range, North first
+    const unsigned int SECTOR_RAW[WIND_VANE_SECTORS] = {
+        3635, 2650, 2800, 1545, 1615, 1490, 1950, 1725,
+        2300, 2150, 3250, 3150, 3945, 3740, 3835, 3450
+    };
+
+    // a real vane wanders between neighbouring sectors with a little ADC noise
+    static unsigned int steady[SAMPLES];
+    // uniformly random readings, including the gaps between the ranges
+    static unsigned int uniform[SAMPLES];
+
+    srand(1);
+    int sector = 0;
+    for (int i = 0; i < SAMPLES; i++) {
+        if (rand() % 8 == 0) {
+            sector = (sector + WIND_VANE_SECTORS + rand() % 3 - 1) % WIND_VANE_SECTORS;
+        }
+        steady[i] = SECTOR_RAW[sector] + rand() % 9 - 4;
+        uniform[i] = 1400 + rand() % 2700;
+    }
+
+    int mismatches = checkAgreement();
+
+    printResult("steady vane:", runBench(steady, SAMPLES, ROUNDS));
+    printResult("uniform ADC values:", runBench(uniform, SAMPLES, ROUNDS));
+    printf("mismatches over 0..4095: %d\n", mismatches);
+
+    return mismatches == 0 ? 0 : 1;
+}
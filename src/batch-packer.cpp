@@ -0,0 +1,402 @@
+#include "batch-packer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum BatchColumnType { COLUMN_I16, COLUMN_U16, COLUMN_U8 };
+
+struct BatchColumn {
+    const char* key;
+    size_t offset;
+    BatchColumnType type;
+};
+
+// the columns every batch carries, in payload order
+static const BatchColumn COLUMNS[] = {
+    { "t", offsetof(TelemetryRecord, tempF), COLUMN_I16 },
+    { "h", offsetof(TelemetryRecord, humidity), COLUMN_U16 },
+    { "p", offsetof(TelemetryRecord, pressure), COLUMN_U16 },
+    { "pt", offsetof(TelemetryRecord, pressureTendency), COLUMN_I16 },
+    { "st", offsetof(TelemetryRecord, soilTempF), COLUMN_I16 },
+    { "m", offsetof(TelemetryRecord, soilMoisture), COLUMN_U8 },
+    { "a", offsetof(TelemetryRecord, windMPH), COLUMN_U16 },
+    { "g", offsetof(TelemetryRecord, gustMPH), COLUMN_U16 },
+    { "d", offsetof(TelemetryRecord, windDegrees), COLUMN_U16 },
+    { "r", offsetof(TelemetryRecord, rainTips), COLUMN_U16 },
+    { "r1", offsetof(TelemetryRecord, rainHourTips), COLUMN_U16 },
+    { "r24", offsetof(TelemetryRecord, rainDayTips), COLUMN_U16 },
+    { "ri", offsetof(TelemetryRecord, rainPeakIntensity), COLUMN_U16 },
+    { "v", offsetof(TelemetryRecord, vcell), COLUMN_U16 },
+    { "c", offsetof(TelemetryRecord, soc), COLUMN_U8 },
+    { "iv", offsetof(TelemetryRecord, interval), COLUMN_U16 },
+    { "ir", offsetof(TelemetryRecord, intervalReason), COLUMN_U8 },
+    { "te", offsetof(TelemetryRecord, hoursToEmpty), COLUMN_U16 },
+    { "pw", offsetof(TelemetryRecord, powerTier), COLUMN_U8 }
+};
+static const int COLUMN_COUNT = sizeof(COLUMNS) / sizeof(COLUMNS[0]);
+
+static const char* const SOIL_PROBE_KEYS[TELEMETRY_SOIL_PROBES] = { "s0", "s1", "s2", "s3" };
+
+// Reads a column value, false if it holds the missing sentinel.
+static bool getColumn(const TelemetryRecord& record, size_t offset, BatchColumnType type, long* value) {
+    const uint8_t* field = (const uint8_t*)&record + offset;
+    switch (type) {
+        case COLUMN_I16: {
+            int16_t v;
+            memcpy(&v, field, sizeof(v));
+            *value = v;
+            return v != TELEMETRY_MISSING_I16;
+        }
+        case COLUMN_U16: {
+            uint16_t v;
+            memcpy(&v, field, sizeof(v));
+            *value = v;
+            return v != TELEMETRY_MISSING_U16;
+        }
+        default:
+            *value = *field;
+            return *field != TELEMETRY_MISSING_U8;
+    }
+}
+
+static void setColumn(TelemetryRecord& record, size_t offset, BatchColumnType type, bool present, long value) {
+    uint8_t* field = (uint8_t*)&record + offset;
+    switch (type) {
+        case COLUMN_I16: {
+            int16_t v = present ? (int16_t)value : TELEMETRY_MISSING_I16;
+            memcpy(field, &v, sizeof(v));
+            break;
+        }
+        case COLUMN_U16: {
+            uint16_t v = present ? (uint16_t)value : TELEMETRY_MISSING_U16;
+            memcpy(field, &v, sizeof(v));
+            break;
+        }
+        default:
+            *field = present ? (uint8_t)value : TELEMETRY_MISSING_U8;
+    }
+}
+
+// Appends to a fixed buffer, remembering whether anything didn't fit.
+class PayloadWriter {
+    public:
+        PayloadWriter(char* buffer, size_t limit) {
+            _buffer = buffer;
+            _limit = limit;
+            _length = 0;
+            _overflow = limit == 0;
+            if (!_overflow) {
+                _buffer[0] = 0;
+            }
+        }
+
+        void text(const char* s) {
+            size_t n = strlen(s);
+            if (_overflow || _length + n + 1 > _limit) {
+                _overflow = true;
+                return;
+            }
+            memcpy(_buffer + _length, s, n + 1);
+            _length += n;
+        }
+
+        void number(long value) {
+            char digits[12];
+            snprintf(digits, sizeof(digits), "%ld", value);
+            text(digits);
+        }
+
+        void key(const char* name, bool first) {
+            text(first ? "\"" : ",\"");
+            text(name);
+            text("\":");
+        }
+
+        bool overflow() {
+            return _overflow;
+        }
+    private:
+        char* _buffer;
+        size_t _limit;
+        size_t _length;
+        bool _overflow;
+};
+
+// Writes the first count records, returns false if they don't fit.
+static bool writeBatch(const TelemetryRecord* records, int count, char* buffer, size_t limit) {
+    PayloadWriter out(buffer, limit);
+    long value;
+
+    out.text("{");
+    out.key("f", true);
+    out.number(BATCH_FORMAT);
+    out.key("k", false);
+    out.number(count);
+    out.key("n", false);
+    out.number(records[0].sequence);
+    out.key("ts", false);
+    out.number(records[0].timestamp);
+    out.key("dt", false);
+    out.text("[");
+    for (int i = 1; i < count; i++) {
+        if (i > 1) out.text(",");
+        out.number((long)(records[i].timestamp - records[i - 1].timestamp));
+    }
+    out.text("]");
+
+    for (int c = 0; c < COLUMN_COUNT; c++) {
+        out.key(COLUMNS[c].key, false);
+        out.text("[");
+        for (int i = 0; i < count; i++) {
+            if (i > 0) out.text(",");
+            if (getColumn(records[i], COLUMNS[c].offset, COLUMNS[c].type, &value)) {
+                out.number(value);
+            } else {
+                out.text("null");
+            }
+        }
+        out.text("]");
+    }
+
+    // the soil profile only costs bytes when there is one
+    int probes = 0;
+    for (int i = 0; i < count; i++) {
+        if (records[i].soilProbeCount > 1 && records[i].soilProbeCount > probes) {
+            probes = records[i].soilProbeCount;
+        }
+    }
+    if (probes > TELEMETRY_SOIL_PROBES) {
+        probes = TELEMETRY_SOIL_PROBES;
+    }
+    if (probes > 0) {
+        out.key("sc", false);
+        out.text("[");
+        for (int i = 0; i < count; i++) {
+            if (i > 0) out.text(",");
+            out.number(records[i].soilProbeCount);
+        }
+        out.text("]");
+
+        for (int probe = 0; probe < probes; probe++) {
+            size_t offset = offsetof(TelemetryRecord, soilProbeTempsF) + probe * sizeof(int16_t);
+            out.key(SOIL_PROBE_KEYS[probe], false);
+            out.text("[");
+            for (int i = 0; i < count; i++) {
+                if (i > 0) out.text(",");
+                if (probe < records[i].soilProbeCount && getColumn(records[i], offset, COLUMN_I16, &value)) {
+                    out.number(value);
+                } else {
+                    out.text("null");
+                }
+            }
+            out.text("]");
+        }
+    }
+
+    out.text("}");
+    return !out.overflow();
+}
+
+int BatchPacker::pack(const TelemetryRecord* records, int count, char* buffer, size_t limit) {
+    // the payload grows with every record, so the largest batch that fits
+    // is found by bisecting on the count
+    int low = 0;
+    int high = count;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (writeBatch(records, mid, buffer, limit)) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    if (low > 0) {
+        writeBatch(records, low, buffer, limit);
+    } else if (limit > 0) {
+        buffer[0] = 0;
+    }
+    return low;
+}
+
+// Minimal reader for the payloads above: one flat object whose values are
+// integers or arrays of integers and nulls.
+class PayloadReader {
+    public:
+        PayloadReader(const char* payload) {
+            _p = payload;
+        }
+
+        bool consume(char c) {
+            skipSpace();
+            if (*_p != c) {
+                return false;
+            }
+            _p++;
+            return true;
+        }
+
+        bool peek(char c) {
+            skipSpace();
+            return *_p == c;
+        }
+
+        bool key(char* name, size_t size) {
+            if (!consume('"')) {
+                return false;
+            }
+            size_t n = 0;
+            while (*_p && *_p != '"') {
+                if (n + 1 < size) {
+                    name[n++] = *_p;
+                }
+                _p++;
+            }
+            name[n] = 0;
+            return consume('"') && consume(':');
+        }
+
+        // an integer, or null which sets present to false
+        bool value(long* value, bool* present) {
+            skipSpace();
+            if (strncmp(_p, "null", 4) == 0) {
+                _p += 4;
+                *present = false;
+                *value = 0;
+                return true;
+            }
+            char* end;
+            *value = strtol(_p, &end, 10);
+            if (end == _p) {
+                return false;
+            }
+            _p = end;
+            *present = true;
+            return true;
+        }
+    private:
+        const char* _p;
+
+        void skipSpace() {
+            while (*_p == ' ' || *_p == '\t' || *_p == '\r' || *_p == '\n') {
+                _p++;
+            }
+        }
+};
+
+int BatchDecoder::decode(const char* payload, TelemetryRecord* records, int max) {
+    PayloadReader in(payload);
+    char name[8];
+    long value;
+    bool present;
+    int count = -1;
+    bool first = true;
+
+    if (!in.consume('{')) {
+        return -1;
+    }
+
+    while (!in.consume('}')) {
+        if (!first && !in.consume(',')) {
+            return -1;
+        }
+        first = false;
+        if (!in.key(name, sizeof(name))) {
+            return -1;
+        }
+
+        // scalars, the count comes first so the columns can be checked
+        if (!in.peek('[')) {
+            if (!in.value(&value, &present) || !present) {
+                return -1;
+            }
+            if (strcmp(name, "f") == 0) {
+                if (value != BATCH_FORMAT) {
+                    return -1;
+                }
+            } else if (strcmp(name, "k") == 0) {
+                if (value < 1 || value > max) {
+                    return -1;
+                }
+                count = value;
+                memset(records, 0, count * sizeof(TelemetryRecord));
+                for (int i = 0; i < count; i++) {
+                    records[i].tempF = TELEMETRY_MISSING_I16;
+                    records[i].humidity = TELEMETRY_MISSING_U16;
+                    records[i].pressure = TELEMETRY_MISSING_U16;
+                    records[i].pressureTendency = TELEMETRY_MISSING_I16;
+                    records[i].hoursToEmpty = TELEMETRY_MISSING_U16;
+                }
+            } else if (count < 0) {
+                return -1;
+            } else if (strcmp(name, "n") == 0) {
+                for (int i = 0; i < count; i++) {
+                    records[i].sequence = value + i;
+                }
+            } else if (strcmp(name, "ts") == 0) {
+                records[0].timestamp = value;
+            }
+            continue;
+        }
+
+        if (count < 0) {
+            return -1;
+        }
+
+        // columns
+        const BatchColumn* column = 0;
+        int probe = -1;
+        for (int c = 0; c < COLUMN_COUNT; c++) {
+            if (strcmp(name, COLUMNS[c].key) == 0) {
+                column = &COLUMNS[c];
+            }
+        }
+        for (int p = 0; p < TELEMETRY_SOIL_PROBES; p++) {
+            if (strcmp(name, SOIL_PROBE_KEYS[p]) == 0) {
+                probe = p;
+            }
+        }
+        bool deltas = strcmp(name, "dt") == 0;
+        bool probeCount = strcmp(name, "sc") == 0;
+
+        in.consume('[');
+        int i = 0;
+        while (!in.consume(']')) {
+            if (i > 0 && !in.consume(',')) {
+                return -1;
+            }
+            if (!in.value(&value, &present)) {
+                return -1;
+            }
+
+            if (deltas) {
+                // kept as deltas until the first timestamp is known
+                if (i + 1 >= count) return -1;
+                records[i + 1].timestamp = value;
+            } else if (i < count) {
+                if (column) {
+                    setColumn(records[i], column->offset, column->type, present, value);
+                } else if (probe >= 0) {
+                    records[i].soilProbeTempsF[probe] = present ? (int16_t)value : TELEMETRY_MISSING_I16;
+                } else if (probeCount) {
+                    records[i].soilProbeCount = value;
+                }
+            }
+            i++;
+        }
+
+        int expected = deltas ? count - 1 : count;
+        if ((column || probe >= 0 || probeCount || deltas) && i != expected) {
+            return -1;
+        }
+    }
+
+    if (count < 0) {
+        return -1;
+    }
+    for (int i = 1; i < count; i++) {
+        records[i].timestamp += records[i - 1].timestamp;
+    }
+    return count;
+}
@@ -0,0 +1,46 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "telemetry-record.h"
+
+#ifndef BatchPacker_h
+#define BatchPacker_h
+
+// Particle event data limit in bytes (255 before Device OS 0.8)
+#define BATCH_EVENT_LIMIT 622
+#define BATCH_FORMAT 1
+
+// Packs several telemetry records into one publish payload, so the
+// connection and per-event overhead is paid once per batch instead of once
+// per reading. The payload is JSON laid out by column, with every value in
+// the record's own integer units, which is much smaller than an object per
+// reading:
+//
+//   {"f":1,"k":3,"n":101,"ts":1700000000,"dt":[900,901],
+//    "t":[723,725,731],"h":[512,508,null],...}
+//
+// f is the format, k the number of readings, n the sequence number of the
+// first one (the rest follow on), ts its timestamp and dt the seconds
+// between readings. Every other key is a column of k values, named after
+// the field it holds in the single reading payload, null where the sensor
+// failed. sc and s0..s3 (the soil profile) are only there when a reading
+// in the batch has more than one soil probe.
+// This file only depends on the C library so it also builds on a host.
+class BatchPacker {
+    public:
+        // Packs as many of the records as fit in limit bytes (including the
+        // terminating 0), which must have consecutive sequence numbers.
+        // Returns the number of records packed, 0 if not even one fits.
+        static int pack(const TelemetryRecord* records, int count, char* buffer, size_t limit);
+};
+
+// Turns a BatchPacker payload back into records.
+class BatchDecoder {
+    public:
+        // Returns the number of records decoded, or -1 if the payload is
+        // malformed or holds more than max records. Unknown keys are
+        // skipped, so newer columns don't break older decoders.
+        static int decode(const char* payload, TelemetryRecord* records, int max);
+};
+
+#endif
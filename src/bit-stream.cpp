@@ -0,0 +1,105 @@
+#include "bit-stream.h"
+
+#include <string.h>
+
+// ctor()
+BitWriter::BitWriter(uint8_t* buffer, size_t size) {
+    _buffer = buffer;
+    _size = size;
+    _bits = 0;
+    _overflow = false;
+    memset(_buffer, 0, _size);
+}
+
+void BitWriter::write(uint32_t value, int bits) {
+    if (_bits + bits > _size * 8) {
+        _overflow = true;
+        return;
+    }
+    put(_bits, value, bits);
+    _bits += bits;
+}
+
+// Overwrites bits already written, e.g. a count that is only known at the end.
+void BitWriter::patch(size_t position, uint32_t value, int bits) {
+    if (position + bits <= _bits) {
+        put(position, value, bits);
+    }
+}
+
+// Drops everything written after the first `bits` bits.
+void BitWriter::truncate(size_t bits) {
+    if (bits >= _bits) {
+        return;
+    }
+    // clear the rest of the last byte kept, then the whole bytes after it
+    for (size_t position = bits; (position & 7) != 0 && position < _bits; position++) {
+        put(position, 0, 1);
+    }
+    size_t firstClearByte = (bits + 7) / 8;
+    memset(_buffer + firstClearByte, 0, getByteCount() - firstClearByte);
+    _bits = bits;
+    _overflow = false;
+}
+
+void BitWriter::put(size_t position, uint32_t value, int bits) {
+    for (int i = bits - 1; i >= 0; i--, position++) {
+        uint8_t mask = 0x80 >> (position & 7);
+        if ((value >> i) & 1) {
+            _buffer[position >> 3] |= mask;
+        } else {
+            _buffer[position >> 3] &= ~mask;
+        }
+    }
+}
+
+size_t BitWriter::getBitCount() {
+    return _bits;
+}
+
+size_t BitWriter::getByteCount() {
+    return (_bits + 7) / 8;
+}
+
+bool BitWriter::overflow() {
+    return _overflow;
+}
+
+// ctor()
+BitReader::BitReader(const uint8_t* buffer, size_t size) {
+    _buffer = buffer;
+    _size = size;
+    _bits = 0;
+    _underflow = false;
+}
+
+uint32_t BitReader::read(int bits) {
+    if (_bits + bits > _size * 8) {
+        _underflow = true;
+        _bits = _size * 8;
+        return 0;
+    }
+
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++, _bits++) {
+        value = (value << 1) | ((_buffer[_bits >> 3] >> (7 - (_bits & 7))) & 1);
+    }
+    return value;
+}
+
+// Reads a two's complement value of the given width.
+int32_t BitReader::readSigned(int bits) {
+    uint32_t value = read(bits);
+    if (bits < 32 && (value & (1UL << (bits - 1)))) {
+        value |= ~((1UL << bits) - 1);
+    }
+    return (int32_t)value;
+}
+
+size_t BitReader::getBitCount() {
+    return _bits;
+}
+
+bool BitReader::underflow() {
+    return _underflow;
+}
@@ -0,0 +1,48 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef BitStream_h
+#define BitStream_h
+
+// Writes values of 1 to 32 bits into a byte buffer, most significant bit
+// first. Writing past the end of the buffer sets the overflow flag instead.
+// This file only depends on the C library so it also builds on a host.
+class BitWriter {
+    public:
+        BitWriter(uint8_t* buffer, size_t size);
+
+        void write(uint32_t value, int bits);
+        void patch(size_t position, uint32_t value, int bits);
+        void truncate(size_t bits);
+
+        size_t getBitCount();
+        size_t getByteCount();
+        bool overflow();
+    private:
+        uint8_t* _buffer;
+        size_t _size;
+        size_t _bits;
+        bool _overflow;
+
+        void put(size_t position, uint32_t value, int bits);
+};
+
+// Reads back what BitWriter wrote. Reading past the end returns zeros and
+// sets the underflow flag.
+class BitReader {
+    public:
+        BitReader(const uint8_t* buffer, size_t size);
+
+        uint32_t read(int bits);
+        int32_t readSigned(int bits);
+
+        size_t getBitCount();
+        bool underflow();
+    private:
+        const uint8_t* _buffer;
+        size_t _size;
+        size_t _bits;
+        bool _underflow;
+};
+
+#endif
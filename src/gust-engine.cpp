@@ -0,0 +1,123 @@
+#include "gust-engine.h"
+
+#include <string.h>
+
+// ctor()
+GustEngine::GustEngine() {
+    _scaleMPH = 0;
+    reset();
+}
+
+void GustEngine::init(float scaleMPH) {
+    _scaleMPH = scaleMPH;
+    reset();
+}
+
+void GustEngine::reset() {
+    _started = false;
+    _startMicros = 0;
+    _lastPulse = 0;
+    _hasLastPulse = false;
+
+    _periodCount = 0;
+    _periodTotal = 0;
+
+    _bucket = 0;
+    memset(_bucketCount, 0, sizeof(_bucketCount));
+    _windowCount = 0;
+    _gustMPH = 0;
+    _gustSampled = false;
+}
+
+void GustEngine::addPulse(uint32_t timestampMicros) {
+    if (!_started) {
+        _started = true;
+        _startMicros = timestampMicros;
+    }
+
+    //If there's never been an event before (first time through), then just capture it
+    if (!_hasLastPulse) {
+        _hasLastPulse = true;
+        _lastPulse = timestampMicros;
+        return;
+    }
+
+    // unsigned differences stay correct when micros() rolls over
+    uint32_t period = timestampMicros - _lastPulse;
+    if (period < ANEMOMETER_DEBOUNCE_US) {
+        return;
+    }
+    _lastPulse = timestampMicros;
+
+    _periodCount++;
+    _periodTotal += period;
+
+    advanceTo((timestampMicros - _startMicros) / GUST_BUCKET_US);
+    _bucketCount[_bucket % GUST_WINDOW_BUCKETS]++;
+    _windowCount++;
+}
+
+// Closes the window at nowMicros, sampling the running mean up to then.
+void GustEngine::finish(uint32_t nowMicros) {
+    if (_started) {
+        advanceTo((nowMicros - _startMicros) / GUST_BUCKET_US);
+    }
+
+    // a window shorter than 3 seconds has no full running mean, its gust is its mean
+    if (!_gustSampled) {
+        _gustMPH = getMeanMPH();
+    }
+}
+
+// Moves the running window forward to bucket, sampling the 3 second mean at
+// every quarter second boundary crossed. At most one pass over the buckets.
+void GustEngine::advanceTo(uint32_t bucket) {
+    uint32_t steps = 0;
+    while (_bucket < bucket && steps <= GUST_WINDOW_BUCKETS) {
+        // the window ending with the current bucket is complete, sample it
+        if (_bucket + 1 >= GUST_WINDOW_BUCKETS) {
+            // pulses counted over the 3 seconds give the mean frequency
+            float seconds = GUST_WINDOW_BUCKETS * (GUST_BUCKET_US / 1000000.0);
+            float speed = _scaleMPH * float(_windowCount) / seconds;
+            if (!_gustSampled || speed > _gustMPH) {
+                _gustMPH = speed;
+            }
+            _gustSampled = true;
+        }
+
+        _bucket++;
+        steps++;
+
+        uint32_t slot = _bucket % GUST_WINDOW_BUCKETS;
+        _windowCount -= _bucketCount[slot];
+        _bucketCount[slot] = 0;
+    }
+
+    // after a quiet spell longer than the window everything has expired
+    if (_bucket < bucket) {
+        _bucket = bucket;
+    }
+}
+
+float GustEngine::speedMPH(uint32_t count, uint32_t periodTotal) {
+    if (count == 0 || periodTotal == 0) {
+        return 0.0;
+    }
+
+    // Nonintuitive math:  We've collected the sum of the observed periods between pulses, and the number of observations.
+    // Now, we calculate the average period (sum / number of readings), take the inverse and muliple by 1000000 to give frequency, and then mulitply by our scale to get MPH.
+    // The math below is transformed to maximize accuracy by doing all muliplications BEFORE dividing.
+    return _scaleMPH * 1000000.0 * float(count) / float(periodTotal);
+}
+
+float GustEngine::getMeanMPH() {
+    return speedMPH(_periodCount, _periodTotal);
+}
+
+float GustEngine::getGustMPH() {
+    return _gustMPH;
+}
+
+uint32_t GustEngine::getPulseCount() {
+    return _periodCount;
+}
@@ -0,0 +1,56 @@
+#include <stdint.h>
+
+#ifndef GustEngine_h
+#define GustEngine_h
+
+// WMO gust: the highest 3 second running mean wind speed, with the running
+// mean sampled every 0.25 seconds.
+#define GUST_WINDOW_BUCKETS 12
+#define GUST_BUCKET_US 250000
+
+// ignore switch-bounce glitches less than 10mS after initial edge (which implies a max windspeed of 149mph)
+#define ANEMOMETER_DEBOUNCE_US 10000
+
+// Turns the anemometer pulse stream into the mean wind speed and the WMO
+// 3 second gust. Pulses are timed in microseconds. As WMO does for cup
+// anemometers, pulses are counted in quarter second buckets and the gust is
+// the highest count over 12 consecutive buckets. Only those 12 counts are
+// kept, so each pulse costs O(1) and memory is fixed however hard the wind
+// blows.
+// This file only depends on the C library so it also builds on a host.
+class GustEngine {
+    public:
+        GustEngine();
+
+        void init(float scaleMPH);
+        void reset();
+        void addPulse(uint32_t timestampMicros);
+        void finish(uint32_t nowMicros);
+
+        float getMeanMPH();
+        float getGustMPH();
+        uint32_t getPulseCount();
+    private:
+        float _scaleMPH; // windspeed if we got a pulse every second (i.e. 1Hz)
+
+        bool _started;
+        uint32_t _startMicros;
+        uint32_t _lastPulse;
+        bool _hasLastPulse;
+
+        // whole window, for the mean
+        uint32_t _periodCount;
+        uint32_t _periodTotal;
+
+        // running 3 second window
+        uint32_t _bucket; // quarter seconds since the first pulse
+        uint16_t _bucketCount[GUST_WINDOW_BUCKETS];
+        uint32_t _windowCount;
+        float _gustMPH;
+        bool _gustSampled;
+
+        void advanceTo(uint32_t bucket);
+        float speedMPH(uint32_t count, uint32_t periodTotal);
+};
+
+#endif
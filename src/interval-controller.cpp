@@ -0,0 +1,102 @@
+#include "interval-controller.h"
+
+#include <math.h>
+
+// ctor()
+IntervalController::IntervalController() {
+    init(15 * 60, 15 * 60, 15 * 60);
+}
+
+void IntervalController::init(uint32_t minSeconds, uint32_t baseSeconds, uint32_t maxSeconds) {
+    _minSeconds = minSeconds;
+    _baseSeconds = baseSeconds < minSeconds ? minSeconds : (baseSeconds > maxSeconds ? maxSeconds : baseSeconds);
+    _maxSeconds = maxSeconds < minSeconds ? minSeconds : maxSeconds;
+
+    _interval = _baseSeconds;
+    _reason = INTERVAL_STEADY;
+    _activity = 0;
+}
+
+uint32_t IntervalController::decide(const IntervalInputs& inputs) {
+    // how fast each input is moving, as a fraction of its fast rate
+    _activity = 0;
+    _reason = INTERVAL_STEADY;
+    if (!isnan(inputs.pressureTendency) && fabs(inputs.pressureTendency) / INTERVAL_FAST_TENDENCY > _activity) {
+        _activity = fabs(inputs.pressureTendency) / INTERVAL_FAST_TENDENCY;
+        _reason = INTERVAL_PRESSURE;
+    }
+    if (!isnan(inputs.tempSlope) && fabs(inputs.tempSlope) / INTERVAL_FAST_TEMP_SLOPE > _activity) {
+        _activity = fabs(inputs.tempSlope) / INTERVAL_FAST_TEMP_SLOPE;
+        _reason = INTERVAL_TEMPERATURE;
+    }
+    // any rain at all counts as fast
+    if (!isnan(inputs.rainIntensity) && inputs.rainIntensity > 0) {
+        float rain = inputs.rainIntensity / INTERVAL_FAST_RAIN;
+        if (rain < 1) {
+            rain = 1;
+        }
+        if (rain > _activity) {
+            _activity = rain;
+            _reason = INTERVAL_RAIN;
+        }
+    }
+
+    // without a single weather input there is nothing to call calm
+    bool known = !isnan(inputs.pressureTendency) || !isnan(inputs.tempSlope) || !isnan(inputs.rainIntensity);
+
+    float interval = _baseSeconds;
+    if (_activity >= 1) {
+        interval = _baseSeconds / _activity;
+    } else if (known && _activity < INTERVAL_CALM_ACTIVITY) {
+        // from twice the base when dead calm down to the base at the calm limit
+        interval = _baseSeconds * (2 - _activity / INTERVAL_CALM_ACTIVITY);
+        _reason = INTERVAL_CALM;
+    } else {
+        _reason = INTERVAL_STEADY;
+    }
+
+    // stretch towards the maximum as the battery runs down
+    if (!isnan(inputs.soc) && inputs.soc < INTERVAL_LOW_SOC) {
+        float drained = (INTERVAL_LOW_SOC - inputs.soc) / (INTERVAL_LOW_SOC - INTERVAL_EMPTY_SOC);
+        if (drained > 1) {
+            drained = 1;
+        }
+        float stretched = _baseSeconds + (_maxSeconds - (float)_baseSeconds) * drained;
+        if (stretched > interval) {
+            interval = stretched;
+            _reason = INTERVAL_LOW_BATTERY;
+        }
+    }
+
+    if (inputs.minInterval > interval) {
+        interval = inputs.minInterval;
+        _reason = INTERVAL_LOW_BATTERY;
+    }
+
+    if (interval < _minSeconds) {
+        interval = _minSeconds;
+    }
+    if (interval > _maxSeconds) {
+        interval = _maxSeconds;
+    }
+    _interval = lroundf(interval);
+    return _interval;
+}
+
+uint32_t IntervalController::getInterval() {
+    return _interval;
+}
+
+IntervalReason IntervalController::getReason() {
+    return _reason;
+}
+
+// Largest input rate as a fraction of its fast rate, from the last decide().
+float IntervalController::getActivity() {
+    return _activity;
+}
+
+const char* IntervalController::getReasonName(IntervalReason reason) {
+    static const char* const NAMES[] = { "steady", "pressure", "temperature", "rain", "calm", "low battery" };
+    return reason <= INTERVAL_LOW_BATTERY ? NAMES[reason] : "unknown";
+}
@@ -0,0 +1,67 @@
+#include <stdint.h>
+
+#ifndef IntervalController_h
+#define IntervalController_h
+
+// rates at which a reading counts as changing fast: a pressure tendency
+// the NWS calls rising or falling rapidly, a temperature change of a front
+// going through, and moderate rain
+#define INTERVAL_FAST_TENDENCY 0.06 // inHg over 3 hours
+#define INTERVAL_FAST_TEMP_SLOPE 5.0 // degF per hour
+#define INTERVAL_FAST_RAIN 0.3 // inches per hour
+
+// below this fraction of a fast rate everything counts as calm
+#define INTERVAL_CALM_ACTIVITY 0.25
+
+// the interval is stretched below this battery charge, up to the maximum
+// at INTERVAL_EMPTY_SOC
+#define INTERVAL_LOW_SOC 50.0
+#define INTERVAL_EMPTY_SOC 20.0
+
+enum IntervalReason {
+    INTERVAL_STEADY = 0, // nothing moving much, the base interval
+    INTERVAL_PRESSURE, // shortened for the pressure tendency
+    INTERVAL_TEMPERATURE, // shortened for the temperature slope
+    INTERVAL_RAIN, // shortened for rain
+    INTERVAL_CALM, // stretched, nothing is changing
+    INTERVAL_LOW_BATTERY // stretched to save the battery
+};
+
+// What the controller looks at. NAN means the value isn't known.
+struct IntervalInputs {
+    float pressureTendency; // inHg over 3 hours
+    float tempSlope; // degF per hour since the previous reading
+    float rainIntensity; // inches per hour, peak since the previous reading
+    float soc; // battery state of charge in %
+    uint32_t minInterval; // seconds, a floor set by the power governor, 0 for none
+};
+
+// Picks the time until the next reading. Each input is scaled by the rate
+// at which it counts as fast and the largest one, the activity, sets the
+// interval: at activity 1 or more the base interval is divided by it, down
+// to the minimum, and a calm reading stretches it up to twice the base.
+// A low battery then stretches the interval towards the maximum, and the
+// power governor's floor applies, whatever the weather is doing.
+// This file only depends on the C library so it also builds on a host.
+class IntervalController {
+    public:
+        IntervalController();
+
+        void init(uint32_t minSeconds, uint32_t baseSeconds, uint32_t maxSeconds);
+        uint32_t decide(const IntervalInputs& inputs);
+
+        uint32_t getInterval();
+        IntervalReason getReason();
+        float getActivity();
+        static const char* getReasonName(IntervalReason reason);
+    private:
+        uint32_t _minSeconds;
+        uint32_t _baseSeconds;
+        uint32_t _maxSeconds;
+
+        uint32_t _interval;
+        IntervalReason _reason;
+        float _activity;
+};
+
+#endif
@@ -45,6 +45,28 @@
 
  #include "SparkFun_Photon_Weather_Shield_Library.h"
 
+ // CRC-8 lookup table for the Si7021/HTU21D checksum, polynomial
+ // x^8 + x^5 + x^4 + 1 (0x31, CRC_POLY unshifted), initial value 0.
+ // Generated once so a checksum costs one table lookup per byte.
+ static const uint8_t CRC8_TABLE[256] = {
+	0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+	0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+	0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+	0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+	0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+	0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+	0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+	0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+	0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+	0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+	0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+	0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+	0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+	0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+	0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+	0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC
+ };
+
  //Initialize
  Weather::Weather(){}
 
@@ -52,8 +74,15 @@
 {
   Wire.begin();
 
+  _i2cTransactions = 0;
+  _dataReadyPin = -1;
+  memset(&_humidityTiming, 0, sizeof(_humidityTiming));
+  memset(&_baroTiming, 0, sizeof(_baroTiming));
+
   uint8_t ID_Barro = IIC_Read(WHO_AM_I );
+  _ctrlReg1 = IIC_Read(CTRL_REG1) & ~(1<<1); //Shadow copy without OST, saves reading it back before every write
   uint8_t ID_Temp_Hum = checkID();
+  _humidityDeviceID = ID_Temp_Hum;
 
   int x,y = 0;
 
@@ -62,9 +91,9 @@
   else
   	x = 0;
 
-  if(ID_Temp_Hum == 0x15)//Ping CheckID register
+  if(ID_Temp_Hum == SI7021_ID)//Ping CheckID register
     y = 1;
-  else if(ID_Temp_Hum == 0x32)
+  else if(ID_Temp_Hum == HTU21D_ID)
     y = 2;
   else
     y = 0;
@@ -104,7 +133,9 @@
 float Weather::getRH()
 {
 	// Measure the relative humidity
-	uint16_t RH_Code = makeMeasurment(HUMD_MEASURE_NOHOLD);
+	// Returns NAN if the sensor did not answer or the checksum did not match
+	uint16_t RH_Code;
+	if (makeMeasurment(HUMD_MEASURE_NOHOLD, &RH_Code) != MEASUREMENT_OK) return NAN;
 	float result = (125.0*RH_Code/65536)-6;
 	return result;
 }
@@ -112,16 +143,39 @@ float Weather::getRH()
 float Weather::readTemp()
 {
 	// Read temperature from previous RH measurement.
-	uint16_t temp_Code = makeMeasurment(TEMP_PREV);
-	float result = (175.25*temp_Code/65536)-46.85;
+	uint16_t temp_Code;
+	if (makeMeasurment(TEMP_PREV, &temp_Code) != MEASUREMENT_OK) return NAN;
+	float result = (175.72*temp_Code/65536)-46.85;
 	return result;
 }
 
+//Relative humidity and temperature in Celsius from a single conversion.
+//The Si7021 measures temperature as part of every RH conversion, so the
+//temperature is fetched with TEMP_PREV instead of running a second one.
+//Nothing is written to humidity or celsius unless MEASUREMENT_OK is returned.
+MeasurementStatus Weather::readHumidityAndTemp(float* humidity, float* celsius)
+{
+	uint16_t RH_Code, temp_Code;
+	MeasurementStatus status = makeMeasurment(HUMD_MEASURE_NOHOLD, &RH_Code);
+	if (status != MEASUREMENT_OK) return status;
+
+	// The HTU21D has no TEMP_PREV command, it needs a conversion of its own
+	uint8_t command = (_humidityDeviceID == HTU21D_ID) ? TEMP_MEASURE_NOHOLD : TEMP_PREV;
+	status = makeMeasurment(command, &temp_Code);
+	if (status != MEASUREMENT_OK) return status;
+
+	*humidity = (125.0*RH_Code/65536)-6;
+	//175.72, not 175.25, per both the Si7021 and the HTU21D datasheets
+	*celsius = (175.72*temp_Code/65536)-46.85;
+	return MEASUREMENT_OK;
+}
+
 float Weather::getTemp()
 {
 	// Measure temperature
-	uint16_t temp_Code = makeMeasurment(TEMP_MEASURE_NOHOLD);
-	float result = (175.25*temp_Code/65536)-46.85;
+	uint16_t temp_Code;
+	if (makeMeasurment(TEMP_MEASURE_NOHOLD, &temp_Code) != MEASUREMENT_OK) return NAN;
+	float result = (175.72*temp_Code/65536)-46.85;
 	return result;
 }
 //Give me temperature in fahrenheit!
@@ -200,50 +254,85 @@ uint8_t Weather::checkID()
 	Wire.endTransmission();
 
     Wire.requestFrom(ADDRESS,1);
+    _i2cTransactions += 2;
 
     ID_1 = Wire.read();
 
     return(ID_1);
 }
 
-uint16_t Weather::makeMeasurment(uint8_t command)
+MeasurementStatus Weather::makeMeasurment(uint8_t command, uint16_t* result)
 {
 	// Take one ADDRESS measurement given by command.
 	// It can be either temperature or relative humidity
-	// TODO: implement checksum checking
+	// A timeout or bad checksum is retried up to MEASUREMENT_RETRIES times,
+	// after that the last error is returned and result is left untouched
 
+	MeasurementStatus status = MEASUREMENT_OK;
+	for (int attempt = 0; attempt <= MEASUREMENT_RETRIES; attempt++) {
+		status = tryMeasurment(command, result);
+		if (status == MEASUREMENT_OK) break;
+	}
+	return status;
+}
+
+MeasurementStatus Weather::tryMeasurment(uint8_t command, uint16_t* result)
+{
 	uint16_t nBytes = 3;
 	// if we are only reading old temperature, read olny msb and lsb
-	if (command == 0xE0) nBytes = 2;
+	if (command == TEMP_PREV) nBytes = 2;
+
+	unsigned long start = micros();
 
 	Wire.beginTransmission(ADDRESS);
 	Wire.write(command);
 	Wire.endTransmission();
-	// When not using clock stretching (*_NOHOLD commands) delay here
-	// is needed to wait for the measurement.
-	// According to datasheet the max. conversion time is ~22ms
-	 delay(100);
-
-	Wire.requestFrom(ADDRESS,nBytes);
-	//Wait for data
-	int counter = 0;
-	while (Wire.available() < nBytes){
-	  delay(1);
-	  counter ++;
-	  if (counter >100){
+	_i2cTransactions++;
+
+	// When not using clock stretching (*_NOHOLD commands) the sensor NACKs
+	// its read address until the measurement is done. Poll it with a short
+	// backoff, so we only wait as long as the conversion actually takes
+	// instead of the worst case. According to datasheet the max. conversion
+	// time is ~22ms.
+	unsigned int backoff = 1;
+	while (Wire.requestFrom(ADDRESS,nBytes) < nBytes){
+	  _i2cTransactions++;
+	  if (micros() - start > SI7021_TIMEOUT_US){
 	    // Timeout: Sensor did not return any data
-	    return 100;
+	    return MEASUREMENT_TIMEOUT;
 	  }
+	  delay(backoff);
+	  if (backoff < 4) backoff <<= 1;
 	}
+	_i2cTransactions++;
+	if (command != TEMP_PREV) recordTiming(&_humidityTiming, micros() - start);
+
+	uint8_t data[3];
+	for (int i = 0; i < nBytes; i++) {
+	  data[i] = Wire.read();
+	}
+
+	// TEMP_PREV only returns msb and lsb, everything else is followed by a checksum
+	if (nBytes == 3 && crc8(data, 2) != data[2]) return MEASUREMENT_BAD_CRC;
 
-	unsigned int msb = Wire.read();
-	unsigned int lsb = Wire.read();
+	unsigned int msb = data[0];
+	unsigned int lsb = data[1];
 	// Clear the last to bits of LSB to 00.
 	// According to datasheet LSB of RH is always xxxxxx10
 	lsb &= 0xFC;
-	unsigned int mesurment = msb << 8 | lsb;
+	*result = msb << 8 | lsb;
 
-	return mesurment;
+	return MEASUREMENT_OK;
+}
+
+uint8_t Weather::crc8(const uint8_t* data, uint8_t length)
+{
+	uint8_t crc = 0;
+	for (uint8_t i = 0; i < length; i++)
+	{
+		crc = CRC8_TABLE[crc ^ data[i]];
+	}
+	return crc;
 }
 
 void Weather::writeReg(uint8_t value)
@@ -253,6 +342,7 @@ void Weather::writeReg(uint8_t value)
 	Wire.write(WRITE_USER_REG);
 	Wire.write(value);
 	Wire.endTransmission();
+	_i2cTransactions++;
 }
 
 uint8_t Weather::readReg()
@@ -262,6 +352,7 @@ uint8_t Weather::readReg()
 	Wire.write(READ_USER_REG);
 	Wire.endTransmission();
 	Wire.requestFrom(ADDRESS,1);
+	_i2cTransactions += 2;
 	uint8_t regVal = Wire.read();
 	return regVal;
 }
@@ -271,28 +362,22 @@ uint8_t Weather::readReg()
 //Returns -1 if no new data is available
 float Weather::readAltitude()
 {
+	unsigned long start = micros();
 	toggleOneShot(); //Toggle the OST bit causing the sensor to immediately take another reading
 
-	//Wait for PDR bit, indicates we have new pressure data
-	int counter = 0;
-	while( (IIC_Read(STATUS) & (1<<1)) == 0)
-	{
-		if(++counter > 600) return(-999); //Error out after max of 512ms for a read
-		delay(1);
-	}
+	//Wait for new pressure data
+	if (!waitForBaroData(start)) return(-999);
 
 	// Read pressure registers
-	Wire.beginTransmission(MPL3115A2_ADDRESS);
-	Wire.write(OUT_P_MSB);  // Address of data to get
-	Wire.endTransmission(false); // Send data to I2C dev with option for a repeated start. THIS IS NECESSARY and not supported before Arduino V1.0.1!
-	if (Wire.requestFrom(MPL3115A2_ADDRESS, 3) != 3) { // Request three bytes
+	byte data[3];
+	if (!IIC_ReadBurst(OUT_P_MSB, data, 3)) { // Request three bytes
 		return -999;
 	}
 
 	byte msb, csb, lsb;
-	msb = Wire.read();
-	csb = Wire.read();
-	lsb = Wire.read();
+	msb = data[0];
+	csb = data[1];
+	lsb = data[2];
 
 	// The least significant bytes l_altitude and l_temp are 4-bit,
 	// fractional values, so you must cast the calulation in (float),
@@ -313,98 +398,221 @@ float Weather::readAltitudeFt()
 
 //Reads the current pressure in Pa
 //Unit must be set in barometric pressure mode
-//Returns -1 if no new data is available
+//Returns -999 if no new data is available
 float Weather::readPressure()
 {
-	//Check PDR bit, if it's not set then toggle OST
-	if(IIC_Read(STATUS) & (1<<2) == 0) toggleOneShot(); //Toggle the OST bit causing the sensor to immediately take another reading
+	float pascals, celsius;
+	if (!readPressureAndTemp(&pascals, &celsius)) return -999;
+	return(pascals);
+}
+
+float Weather::readBaroTemp()
+{
+	float pascals, celsius;
+	if (!readPressureAndTemp(&pascals, &celsius)) return -999;
+	return(celsius);
+}
+
+//Takes a fresh one-shot reading and returns both pressure in Pa and temperature
+//in Celsius. OUT_P_MSB through OUT_T_LSB are read in a single 5 byte
+//auto-increment transfer instead of one transfer per value.
+//Returns false if the sensor did not answer in time.
+bool Weather::readPressureAndTemp(float* pascals, float* celsius)
+{
+	unsigned long start = micros();
+	toggleOneShot(); //Set the OST bit causing the sensor to immediately take a reading
+
+	//Wait for new pressure and temp data
+	if (!waitForBaroData(start)) return false;
+
+	byte data[5];
+	if (!IIC_ReadBurst(OUT_P_MSB, data, 5)) return false;
 
-	//Wait for PDR bit, indicates we have new pressure data
-	int counter = 0;
-	while(IIC_Read(STATUS) & (1<<2) == 0)
+	*pascals = decodePressure(data[0], data[1], data[2]);
+	*celsius = decodeBaroTemp(data[3], data[4]);
+	return true;
+}
+
+//Starts a one-shot reading and returns right away, for callers that have
+//other work to do during the conversion. Returns the conversion time in ms,
+//about 2 + 4 * 2^OS (6 ms to 514 ms), after which pollPressureAndTemp()
+//should find the reading done.
+unsigned long Weather::startPressureAndTemp()
+{
+	_baroStart = micros();
+	toggleOneShot(); //Set the OST bit causing the sensor to immediately take a reading
+
+	byte oversample = (_ctrlReg1 >> 3) & 0x07;
+	return 2 + (4 << oversample);
+}
+
+//Checks once on the reading started by startPressureAndTemp(). Returns
+//MEASUREMENT_OK with both values once it is in, MEASUREMENT_PENDING while
+//the sensor is still converting and MEASUREMENT_TIMEOUT if it did not
+//answer in time.
+MeasurementStatus Weather::pollPressureAndTemp(float* pascals, float* celsius)
+{
+	if (!baroDataReady())
 	{
-		if(++counter > 600) return(-999); //Error out after max of 512ms for a read
-		delay(1);
+		return micros() - _baroStart > MPL3115A2_TIMEOUT_US ? MEASUREMENT_TIMEOUT : MEASUREMENT_PENDING;
 	}
+	recordTiming(&_baroTiming, micros() - _baroStart);
 
-	// Read pressure registers
-	Wire.beginTransmission(MPL3115A2_ADDRESS);
-	Wire.write(OUT_P_MSB);  // Address of data to get
-	Wire.endTransmission(false); // Send data to I2C dev with option for a repeated start. THIS IS NECESSARY and not supported before Arduino V1.0.1!
-	if (Wire.requestFrom(MPL3115A2_ADDRESS, 3) != 3) { // Request three bytes
-		return -999;
-	}
+	byte data[5];
+	if (!IIC_ReadBurst(OUT_P_MSB, data, 5)) return MEASUREMENT_TIMEOUT;
 
-	byte msb, csb, lsb;
-	msb = Wire.read();
-	csb = Wire.read();
-	lsb = Wire.read();
+	*pascals = decodePressure(data[0], data[1], data[2]);
+	*celsius = decodeBaroTemp(data[3], data[4]);
+	return MEASUREMENT_OK;
+}
 
-	toggleOneShot(); //Toggle the OST bit causing the sensor to immediately take another reading
+//Lets the sensor log pressure on its own into the 32 sample on-chip FIFO.
+//A sample is taken every 2^timeStep seconds (0-15), once full the FIFO keeps
+//the newest 32 samples. Call readFifo() to drain it. The sensor stays in
+//active mode, so one-shot readings are not available while the FIFO is on.
+void Weather::enableFifo(byte timeStep)
+{
+	if(timeStep > 15) timeStep = 15; //ST is a 4 bit field
 
-	// Pressure comes back as a left shifted 20 bit number
-	long pressure_whole = (long)msb<<16 | (long)csb<<8 | (long)lsb;
-	pressure_whole >>= 6; //Pressure is an 18 bit number with 2 bits of decimal. Get rid of decimal portion.
+	setModeStandby(); //FIFO and time step can only be changed in standby
 
-	lsb &= 0b00110000; //Bits 5/4 represent the fractional component
-	lsb >>= 4; //Get it right aligned
-	float pressure_decimal = (float)lsb/4.0; //Turn it into fraction
+	IIC_Write(F_SETUP, 0); //Disable the FIFO first, this also empties it
+	IIC_Write(F_SETUP, (1<<6)); //F_MODE = 01, circular buffer, oldest sample is overwritten
+	IIC_Write(CTRL_REG2, timeStep); //Auto acquisition time step
 
-	float pressure = (float)pressure_whole + pressure_decimal;
+	setModeActive();
+}
 
-	return(pressure);
+void Weather::disableFifo()
+{
+	setModeStandby(); //Back to one-shot readings
+	IIC_Write(F_SETUP, 0);
 }
 
-float Weather::readBaroTemp()
+//Drains the FIFO into samples, oldest first, and returns how many were read.
+//The samples are pulled with as few transfers as the Wire buffer allows.
+byte Weather::readFifo(PressureSample* samples, byte maxSamples)
 {
-	if(IIC_Read(STATUS) & (1<<1) == 0) toggleOneShot(); //Toggle the OST bit causing the sensor to immediately take another reading
+	byte fifoStatus = IIC_Read(F_STATUS);
+	byte count = fifoStatus & 0x3F; //F_CNT, number of samples waiting
+	if(count > maxSamples) count = maxSamples;
 
-	//Wait for TDR bit, indicates we have new temp data
-	int counter = 0;
-	while( (IIC_Read(STATUS) & (1<<1)) == 0)
+	byte read = 0;
+	while(read < count)
 	{
-		if(++counter > 600) return(-999); //Error out after max of 512ms for a read
-		delay(1);
+		byte chunk = count - read;
+		if(chunk > IIC_BURST_MAX / 5) chunk = IIC_BURST_MAX / 5;
+
+		//The register pointer does not move past F_DATA, each burst pops whole samples
+		byte data[IIC_BURST_MAX];
+		if (!IIC_ReadBurst(F_DATA, data, chunk * 5)) break;
+
+		for(byte i = 0; i < chunk; i++)
+		{
+			byte* sample = data + i * 5;
+			samples[read + i].pascals = decodePressure(sample[0], sample[1], sample[2]);
+			samples[read + i].celsius = decodeBaroTemp(sample[3], sample[4]);
+		}
+		read += chunk;
 	}
 
-	// Read temperature registers
-	Wire.beginTransmission(MPL3115A2_ADDRESS);
-	Wire.write(OUT_T_MSB);  // Address of data to get
-	Wire.endTransmission(false); // Send data to I2C dev with option for a repeated start. THIS IS NECESSARY and not supported before Arduino V1.0.1!
-	if (Wire.requestFrom(MPL3115A2_ADDRESS, 2) != 2) { // Request two bytes
-		return -999;
-	}
+	return read;
+}
 
-	byte msb, lsb;
-	msb = Wire.read();
-	lsb = Wire.read();
+//Routes the data ready interrupt to the INT1 pin, which must be wired to pin.
+//Readings then wait on the pin instead of polling STATUS over I2C.
+void Weather::enableDataReadyInterrupt(int pin)
+{
+	setModeStandby(); //Interrupt configuration can only be changed in standby
+	IIC_Write(CTRL_REG3, 0x00); //INT1 active low, push-pull
+	IIC_Write(CTRL_REG4, (1<<7)); //INT_EN_DRDY, interrupt on data ready
+	IIC_Write(CTRL_REG5, (1<<7)); //INT_CFG_DRDY, route it to INT1
 
-	toggleOneShot(); //Toggle the OST bit causing the sensor to immediately take another reading
+	_dataReadyPin = pin;
+	pinMode(_dataReadyPin, INPUT_PULLUP);
+}
 
-    //Negative temperature fix by D.D.G.
-    uint16_t foo = 0;
-    bool negSign = false;
+//Waits until a one-shot reading started at start (micros) is done.
+//The conversion time depends on the oversample rate, so we first sleep
+//through most of it and then check with a short backoff. Only for the
+//blocking reads, a caller with other work to do polls instead.
+bool Weather::waitForBaroData(unsigned long start)
+{
+	byte oversample = (_ctrlReg1 >> 3) & 0x07;
+	delay(4 << oversample); //Conversion takes about 2 + 4 * 2^OS ms (6 ms to 514 ms)
 
-    //Check for 2s compliment
-	if(msb > 0x7F)
+	unsigned int backoff = 1;
+	while(!baroDataReady())
 	{
-        foo = ~((msb << 8) + lsb) + 1;  //2’s complement
-        msb = foo >> 8;
-        lsb = foo & 0x00F0;
-        negSign = true;
+		if(micros() - start > MPL3115A2_TIMEOUT_US) return false;
+		delay(backoff);
+		if (backoff < 4) backoff <<= 1;
 	}
 
-	// The least significant bytes l_altitude and l_temp are 4-bit,
-	// fractional values, so you must cast the calulation in (float),
-	// shift the value over 4 spots to the right and divide by 16 (since
-	// there are 16 values in 4-bits).
-	float templsb = (lsb>>4)/16.0; //temp, fraction of a degree
+	recordTiming(&_baroTiming, micros() - start);
+	return true;
+}
 
-	float temperature = (float)(msb + templsb);
+//Whether the one-shot reading is done, from the INT1 pin when it's wired
+//up or the PTDR bit (new pressure and temp data) of STATUS otherwise
+bool Weather::baroDataReady()
+{
+	if (_dataReadyPin >= 0)
+	{
+		return digitalRead(_dataReadyPin) == LOW;
+	}
+	return IIC_Read(STATUS) & (1<<3);
+}
 
-	if (negSign) temperature = 0 - temperature;
+//Conversion times measured on the last and all readings since power up
+SensorTiming Weather::getHumidityTiming()
+{
+	return _humidityTiming;
+}
 
-	return(temperature);
+SensorTiming Weather::getBaroTiming()
+{
+	return _baroTiming;
+}
+
+void Weather::recordTiming(SensorTiming* timing, unsigned long elapsed)
+{
+	timing->count++;
+	timing->lastMicros = elapsed;
+	timing->totalMicros += elapsed;
+}
+
+//Number of I2C transactions made since the last reset, used to measure
+//how much bus traffic a reading costs
+unsigned long Weather::getI2CTransactionCount()
+{
+	return _i2cTransactions;
+}
+
+void Weather::resetI2CTransactionCount()
+{
+	_i2cTransactions = 0;
+}
+
+float Weather::decodePressure(byte msb, byte csb, byte lsb)
+{
+	// Pressure comes back as a left shifted 20 bit number
+	long pressure_whole = (long)msb<<16 | (long)csb<<8 | (long)lsb;
+	pressure_whole >>= 6; //Pressure is an 18 bit number with 2 bits of decimal. Get rid of decimal portion.
+
+	lsb &= 0b00110000; //Bits 5/4 represent the fractional component
+	lsb >>= 4; //Get it right aligned
+	float pressure_decimal = (float)lsb/4.0; //Turn it into fraction
+
+	return (float)pressure_whole + pressure_decimal;
+}
+
+float Weather::decodeBaroTemp(byte msb, byte lsb)
+{
+	// Temperature is a signed 12 bit number, 8 bits whole degrees and a
+	// 4 bit fraction, left aligned in the two registers
+	int16_t raw = (int16_t)((msb << 8) | lsb);
+	return (float)raw / 256.0;
 }
 
 //Give me temperature in fahrenheit!
@@ -417,36 +625,32 @@ float Weather::readBaroTempF()
 //CTRL_REG1, ALT bit
 void Weather::setModeBarometer()
 {
-  byte tempSetting = IIC_Read(CTRL_REG1); //Read current settings
-  tempSetting &= ~(1<<7); //Clear ALT bit
-  IIC_Write(CTRL_REG1, tempSetting);
+  _ctrlReg1 &= ~(1<<7); //Clear ALT bit
+  IIC_Write(CTRL_REG1, _ctrlReg1);
 }
 
 //Sets the mode to Altimeter
 //CTRL_REG1, ALT bit
 void Weather::setModeAltimeter()
 {
-  byte tempSetting = IIC_Read(CTRL_REG1); //Read current settings
-  tempSetting |= (1<<7); //Set ALT bit
-  IIC_Write(CTRL_REG1, tempSetting);
+  _ctrlReg1 |= (1<<7); //Set ALT bit
+  IIC_Write(CTRL_REG1, _ctrlReg1);
 }
 
 //Puts the sensor in standby mode
 //This is needed so that we can modify the major control registers
 void Weather::setModeStandby()
 {
-  byte tempSetting = IIC_Read(CTRL_REG1); //Read current settings
-  tempSetting &= ~(1<<0); //Clear SBYB bit for Standby mode
-  IIC_Write(CTRL_REG1, tempSetting);
+  _ctrlReg1 &= ~(1<<0); //Clear SBYB bit for Standby mode
+  IIC_Write(CTRL_REG1, _ctrlReg1);
 }
 
 //Puts the sensor in active mode
 //This is needed so that we can modify the major control registers
 void Weather::setModeActive()
 {
-  byte tempSetting = IIC_Read(CTRL_REG1); //Read current settings
-  tempSetting |= (1<<0); //Set SBYB bit for Active mode
-  IIC_Write(CTRL_REG1, tempSetting);
+  _ctrlReg1 |= (1<<0); //Set SBYB bit for Active mode
+  IIC_Write(CTRL_REG1, _ctrlReg1);
 }
 
 //Call with a rate from 0 to 7. See page 33 for table of ratios.
@@ -458,10 +662,9 @@ void Weather::setOversampleRate(byte sampleRate)
   if(sampleRate > 7) sampleRate = 7; //OS cannot be larger than 0b.0111
   sampleRate <<= 3; //Align it for the CTRL_REG1 register
 
-  byte tempSetting = IIC_Read(CTRL_REG1); //Read current settings
-  tempSetting &= 0b11000111; //Clear out old OS bits
-  tempSetting |= sampleRate; //Mask in new OS bits
-  IIC_Write(CTRL_REG1, tempSetting);
+  _ctrlReg1 &= 0b11000111; //Clear out old OS bits
+  _ctrlReg1 |= sampleRate; //Mask in new OS bits
+  IIC_Write(CTRL_REG1, _ctrlReg1);
 }
 
 //Enables the pressure and temp measurement event flags so that we can
@@ -471,17 +674,13 @@ void Weather::enableEventFlags()
   IIC_Write(PT_DATA_CFG, 0x07); // Enable all three pressure and temp event flags
 }
 
-//Clears then sets the OST bit which causes the sensor to immediately take another reading
+//Sets the OST bit which causes the sensor to immediately take another reading
 //Needed to sample faster than 1Hz
+//The shadow copy never has OST set and the sensor clears it once a reading is
+//done, so a single write is enough instead of read/clear/read/set
 void Weather::toggleOneShot(void)
 {
-  byte tempSetting = IIC_Read(CTRL_REG1); //Read current settings
-  tempSetting &= ~(1<<1); //Clear OST bit
-  IIC_Write(CTRL_REG1, tempSetting);
-
-  tempSetting = IIC_Read(CTRL_REG1); //Read current settings to be safe
-  tempSetting |= (1<<1); //Set OST bit
-  IIC_Write(CTRL_REG1, tempSetting);
+  IIC_Write(CTRL_REG1, _ctrlReg1 | (1<<1)); //Set OST bit
 }
 
 
@@ -493,6 +692,7 @@ byte Weather::IIC_Read(byte regAddr)
   Wire.write(regAddr);  // Address of CTRL_REG1
   Wire.endTransmission(false); // Send data to I2C dev with option for a repeated start. THIS IS NECESSARY and not supported before Arduino V1.0.1!
   Wire.requestFrom(MPL3115A2_ADDRESS, 1); // Request the data...
+  _i2cTransactions++;
   return Wire.read();
 }
 
@@ -503,4 +703,22 @@ void Weather::IIC_Write(byte regAddr, byte value)
   Wire.write(regAddr);
   Wire.write(value);
   Wire.endTransmission(true);
+  _i2cTransactions++;
+}
+
+bool Weather::IIC_ReadBurst(byte regAddr, byte* data, byte length)
+{
+  // This function reads several consecutive registers in one transfer,
+  // the sensor auto-increments the register address after each byte
+  Wire.beginTransmission(MPL3115A2_ADDRESS);
+  Wire.write(regAddr);
+  Wire.endTransmission(false); // Send data to I2C dev with option for a repeated start
+  byte received = Wire.requestFrom(MPL3115A2_ADDRESS, length);
+  _i2cTransactions++;
+  if (received != length) return false;
+
+  for (byte i = 0; i < length; i++) {
+    data[i] = Wire.read();
+  }
+  return true;
 }
@@ -52,6 +52,9 @@
 
 #define ADDRESS      0x40
 
+#define SI7021_ID    0x15 // CheckID answers
+#define HTU21D_ID    0x32
+
 #define TEMP_MEASURE_HOLD  0xE3
 #define HUMD_MEASURE_HOLD  0xE5
 #define TEMP_MEASURE_NOHOLD  0xF3
@@ -67,10 +70,22 @@
 
 #define CRC_POLY 0x988000 // Shifted Polynomial for CRC check
 
+#define SI7021_TIMEOUT_US 50000 // Give up on a measurement after 50ms, the datasheet max is ~22ms
+
 // Error codes
 #define I2C_TIMEOUT 	998
 #define BAD_CRC		999
 
+#define MEASUREMENT_RETRIES 2 // Extra attempts after a timeout or bad checksum
+
+// Result of a Si7021/HTU21D measurement, or of polling for an MPL3115A2 reading
+enum MeasurementStatus {
+	MEASUREMENT_OK = 0,
+	MEASUREMENT_PENDING = 1, // Still converting, poll again later
+	MEASUREMENT_TIMEOUT = I2C_TIMEOUT,
+	MEASUREMENT_BAD_CRC = BAD_CRC
+};
+
 /****************MPL3115A2 Definitions************************************/
 #define MPL3115A2_ADDRESS 0x60 // Unshifted 7-bit I2C address for sensor
 
@@ -121,6 +136,25 @@
 #define OFF_T      0x2C
 #define OFF_H      0x2D
 
+#define FIFO_SIZE  32 // Samples held by the MPL3115A2 FIFO
+
+#define MPL3115A2_TIMEOUT_US 600000 // Give up on a reading after 600ms, 512ms at the max oversample rate
+
+#define IIC_BURST_MAX 30 // Largest burst read, the Wire buffer holds 32 bytes
+
+// Conversion times measured by one of the sensors
+struct SensorTiming {
+	unsigned long count; // Readings timed
+	unsigned long lastMicros; // Conversion time of the last reading
+	unsigned long totalMicros; // Sum of all conversion times
+};
+
+// One pressure and temperature reading pulled from the MPL3115A2 FIFO
+struct PressureSample {
+	float pascals;
+	float celsius;
+};
+
 /****************Si7021 & HTU21D Class**************************************/
 class Weather
 {
@@ -131,7 +165,8 @@ public:
 	void  begin();
 
 	// Si7021 & HTU21D Public Functions
-	float getRH();
+	float getRH(); // NAN if the measurement failed, as for the other float getters
+	MeasurementStatus readHumidityAndTemp(float* humidity, float* celsius); // Both from one RH conversion.
 	float readTemp();
 	float getTemp();
 	float readTempF();
@@ -148,6 +183,12 @@ public:
 	float readPressure(); // Returns float with barometric pressure in Pa. Ex: 83351.25
 	float readBaroTemp(); // Returns float with current temperature in Celsius. Ex: 23.37
 	float readBaroTempF(); // Returns float with current temperature in Fahrenheit. Ex: 73.96
+	bool readPressureAndTemp(float* pascals, float* celsius); // Both values from one reading and one burst transfer. Returns false on timeout.
+	unsigned long startPressureAndTemp(); // Starts a one-shot reading without waiting for it. Returns the conversion time in ms.
+	MeasurementStatus pollPressureAndTemp(float* pascals, float* celsius); // Picks up the reading started above, MEASUREMENT_PENDING until it's in.
+	void enableFifo(byte timeStep); // Log a sample every 2^timeStep seconds into the on-chip FIFO.
+	void disableFifo(); // Back to one-shot readings.
+	byte readFifo(PressureSample* samples, byte maxSamples); // Drains the FIFO, oldest sample first. Returns the number read.
 	void setModeBarometer(); // Puts the sensor into Pascal measurement mode.
 	void setModeAltimeter(); // Puts the sensor into altimetery mode.
 	void setModeStandby(); // Puts the sensor into Standby mode. Required when changing CTRL1 register.
@@ -155,16 +196,41 @@ public:
 	void setOversampleRate(byte); // Sets the # of samples from 1 to 128. See datasheet.
 	void enableEventFlags(); // Sets the fundamental event flags. Required during setup.
 
+	void enableDataReadyInterrupt(int pin); // Wait for readings on the INT1 pin instead of polling STATUS.
+
+	SensorTiming getHumidityTiming(); // Si7021/HTU21D conversion times.
+	SensorTiming getBaroTiming(); // MPL3115A2 conversion times.
+	unsigned long getI2CTransactionCount(); // I2C transactions on either sensor since the last reset.
+	void resetI2CTransactionCount();
+
 private:
 	//Si7021 & HTU21D Private Functions
-	uint16_t makeMeasurment(uint8_t command);
+	MeasurementStatus makeMeasurment(uint8_t command, uint16_t* result);
+	MeasurementStatus tryMeasurment(uint8_t command, uint16_t* result);
+	uint8_t  crc8(const uint8_t* data, uint8_t length);
 	void     writeReg(uint8_t value);
 	uint8_t  readReg();
 
 	//MPL3115A2 Private Functions
 	void toggleOneShot();
+	bool waitForBaroData(unsigned long start);
+	bool baroDataReady();
+	float decodePressure(byte msb, byte csb, byte lsb);
+	float decodeBaroTemp(byte msb, byte lsb);
 	byte IIC_Read(byte regAddr);
 	void IIC_Write(byte regAddr, byte value);
+	bool IIC_ReadBurst(byte regAddr, byte* data, byte length);
+
+	uint8_t _humidityDeviceID; // SI7021_ID or HTU21D_ID
+
+	byte _ctrlReg1; // Shadow copy of CTRL_REG1, OST always clear
+	unsigned long _i2cTransactions;
+	int _dataReadyPin; // Pin wired to INT1, -1 to poll STATUS instead
+	unsigned long _baroStart; // micros() when the pending one-shot reading was started
+
+	void recordTiming(SensorTiming* timing, unsigned long elapsed);
+	SensorTiming _humidityTiming;
+	SensorTiming _baroTiming;
 };
 
 #endif
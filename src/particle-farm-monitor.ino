@@ -1,19 +1,28 @@
 #include "weather-service.h"
-#define MINUTES_TO_SLEEP (15*60)
+
+// keep the backup SRAM powered so retained variables survive sleep and reset
+STARTUP(System.enableFeature(FEATURE_RETAINED_MEMORY));
+
+// run the application thread without waiting for the cloud, so a rain gauge
+// wake can log its tip and go back to sleep without bringing the radio up
+SYSTEM_MODE(SEMI_AUTOMATIC);
+SYSTEM_THREAD(ENABLED);
 
 WeatherService weatherService;
 
 // setup() runs once, when the device is first turned on.
 void setup() {
 
-  // initialize the weather service, true = debug, false = production
+  // initialize the weather service, true = debug, false = production. A
+  // second true adds trace lines to the debug output for host/trace-replay
   weatherService.init(false);
+  weatherService.setSleepBounds(MIN_SECONDS_TO_SLEEP, MINUTES_TO_SLEEP, MAX_SECONDS_TO_SLEEP);
 }
 
 // loop() runs over and over again, as quickly as it can execute.
 void loop() {
-  char* json = weatherService.getWeatherData();
-  Particle.publish("w", json, PRIVATE);
-
-  System.sleep(weatherService.getRainGaugeSignalPin(), FALLING, MINUTES_TO_SLEEP);
-}
\ No newline at end of file
+  // run the acquisition cycle when it's due, then sleep until the next one
+  // or a rain gauge tip
+  LoopPass pass = weatherService.runOnce();
+  weatherService.sleep(pass.sleepSeconds);
+}
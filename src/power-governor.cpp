@@ -0,0 +1,82 @@
+#include "power-governor.h"
+
+#include <math.h>
+
+// ctor()
+PowerGovernor::PowerGovernor() {
+    _state = 0;
+    _tiers = 0;
+    _tierCount = 0;
+}
+
+void PowerGovernor::init(PowerState* state, const PowerTier* tiers, int tierCount) {
+    _state = state;
+    _tiers = tiers;
+    _tierCount = tierCount;
+
+    if (_state->tier >= _tierCount) {
+        _state->tier = 0;
+    }
+}
+
+// Picks the tier for the charge left. Going down is immediate, going back
+// up needs POWER_TIER_HYSTERESIS % of margin. An unknown charge keeps the
+// current tier.
+const PowerTier& PowerGovernor::update(float soc) {
+    if (isnan(soc)) {
+        return getTier();
+    }
+
+    while (_state->tier + 1 < _tierCount && soc < _tiers[_state->tier].minSoC) {
+        _state->tier++;
+    }
+    while (_state->tier > 0 && soc >= _tiers[_state->tier - 1].minSoC + POWER_TIER_HYSTERESIS) {
+        _state->tier--;
+    }
+    return getTier();
+}
+
+const PowerTier& PowerGovernor::getTier() {
+    return _tiers[_state->tier];
+}
+
+// Adds a cycle to the running average current: awakeMs running in total,
+// radioMs of which with the radio up, then sleepSeconds asleep.
+void PowerGovernor::recordCycle(uint32_t awakeMs, uint32_t radioMs, uint32_t sleepSeconds) {
+    float hours = (awakeMs / 1000.0 + sleepSeconds) / 3600.0;
+    if (hours <= 0) {
+        return;
+    }
+
+    if (radioMs > awakeMs) {
+        radioMs = awakeMs;
+    }
+    float mah = (radioMs * POWER_RADIO_MA + (awakeMs - radioMs) * POWER_AWAKE_MA) / 3600000.0
+        + sleepSeconds * POWER_SLEEP_MA / 3600.0;
+
+    _state->lastCycleMah = mah;
+    float milliamps = mah / hours;
+    if (_state->cycles == 0) {
+        _state->averageMilliamps = milliamps;
+    } else {
+        _state->averageMilliamps += POWER_AVERAGE_WEIGHT * (milliamps - _state->averageMilliamps);
+    }
+    _state->cycles++;
+}
+
+float PowerGovernor::getAverageMilliamps() {
+    return _state->averageMilliamps;
+}
+
+float PowerGovernor::getLastCycleMah() {
+    return _state->lastCycleMah;
+}
+
+// Hours until the battery is empty at the average current, NAN until a
+// cycle has been recorded or without a charge reading.
+float PowerGovernor::getHoursToEmpty(float soc) {
+    if (_state->cycles == 0 || _state->averageMilliamps <= 0 || isnan(soc)) {
+        return NAN;
+    }
+    return POWER_BATTERY_MAH * soc / 100.0 / _state->averageMilliamps;
+}
@@ -0,0 +1,63 @@
+#include <stdint.h>
+
+#ifndef PowerGovernor_h
+#define PowerGovernor_h
+
+// current draw in mA used for the energy estimate (Electron, 3.7V LiPo)
+#define POWER_AWAKE_MA 50.0 // running, radio off
+#define POWER_RADIO_MA 180.0 // cellular connected, publishing
+#define POWER_SLEEP_MA 2.0 // stop mode sleep
+#define POWER_BATTERY_MAH 2000.0
+
+// a tier is only left for a higher one once the charge is this far above
+// the higher tier's threshold, so the tier doesn't flap around a threshold
+#define POWER_TIER_HYSTERESIS 5.0
+
+// weight of the newest cycle in the running average current
+#define POWER_AVERAGE_WEIGHT 0.1
+
+// What the firmware may spend in one tier of battery charge.
+struct PowerTier {
+    const char* name;
+    float minSoC; // % of charge the tier applies from
+    uint32_t minInterval; // seconds, the shortest time between readings
+    uint8_t uploadEveryCycles; // readings logged per connection
+    uint16_t anemometerWindow; // ms, at least 3000 for the 3 second gust
+    uint8_t windVaneSamples; // one every 200 ms
+    bool optionalSensors; // soil temperature profile and soil moisture
+};
+
+// Governor state, meant to live in retained memory.
+struct PowerState {
+    uint8_t tier;
+    float averageMilliamps; // running average over whole cycles, 0 until the first one
+    float lastCycleMah;
+    uint32_t cycles;
+};
+
+// Steps the firmware down through the power tiers as the battery drains,
+// and keeps a running estimate of the average current from the time spent
+// awake, with the radio on and asleep each cycle, to predict the time to
+// empty.
+// This file only depends on the C library so it also builds on a host.
+class PowerGovernor {
+    public:
+        PowerGovernor();
+
+        // tiers are listed from the highest charge down, the last one
+        // should start at 0%
+        void init(PowerState* state, const PowerTier* tiers, int tierCount);
+        const PowerTier& update(float soc);
+        const PowerTier& getTier();
+
+        void recordCycle(uint32_t awakeMs, uint32_t radioMs, uint32_t sleepSeconds);
+        float getAverageMilliamps();
+        float getLastCycleMah();
+        float getHoursToEmpty(float soc);
+    private:
+        PowerState* _state;
+        const PowerTier* _tiers;
+        int _tierCount;
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include <stdint.h>
+
+#ifndef PulseRingBuffer_h
+#define PulseRingBuffer_h
+
+// Fixed size single-producer/single-consumer ring of pulse timestamps.
+//
+// An interrupt handler push()es and the main loop pop()s. The head is only
+// written by the producer and the tail only by the consumer, and aligned
+// 32 bit loads and stores are atomic on the Cortex-M3, so neither side
+// needs to disable interrupts. SIZE must be a power of two. Pushes that find
+// the ring full are dropped and counted as overflows.
+template <uint32_t SIZE>
+class PulseRingBuffer {
+    public:
+        PulseRingBuffer() : _head(0), _tail(0), _overflows(0) {}
+
+        // producer side, safe to call from an ISR
+        inline bool push(uint32_t timestamp) {
+            uint32_t head = _head;
+            if (head - _tail >= SIZE) {
+                _overflows++;
+                return false;
+            }
+
+            _buffer[head & (SIZE - 1)] = timestamp;
+            __sync_synchronize(); // the slot must be written before the consumer sees the new head
+            _head = head + 1;
+            return true;
+        }
+
+        // consumer side, returns false when the ring is empty
+        inline bool pop(uint32_t* timestamp) {
+            uint32_t tail = _tail;
+            if (tail == _head) {
+                return false;
+            }
+
+            *timestamp = _buffer[tail & (SIZE - 1)];
+            __sync_synchronize(); // read the slot before handing it back to the producer
+            _tail = tail + 1;
+            return true;
+        }
+
+        inline uint32_t getOverflowCount() {
+            return _overflows;
+        }
+    private:
+        volatile uint32_t _buffer[SIZE];
+        volatile uint32_t _head;
+        volatile uint32_t _tail;
+        volatile uint32_t _overflows;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "rain-engine.h"
+
+#include <string.h>
+
+// ctor()
+RainEngine::RainEngine() {
+    _history = 0;
+    _log = 0;
+}
+
+// Attaches the engine to its history and the tip log. A history that
+// doesn't carry the magic number (cold boot, a discarded retained block or
+// an older layout) is cleared, and the log with it, as nothing says which of
+// its tips were counted. A log that fails its own check, or whose head is
+// behind the tips already processed, starts over from the history.
+void RainEngine::init(RainHistory* history, RainTipLog* log) {
+    _history = history;
+    _log = log;
+
+    bool cleared = false;
+    if (_history->magic != RAIN_HISTORY_MAGIC) {
+        memset(_history, 0, sizeof(RainHistory));
+        _history->magic = RAIN_HISTORY_MAGIC;
+        cleared = true;
+    }
+
+    if (cleared || _log->magic != RAIN_TIP_LOG_MAGIC || _log->headCheck != ~_log->head
+            || (int32_t)(_log->head - _history->processed) < 0) {
+        memset(_log, 0, sizeof(RainTipLog));
+        _log->magic = RAIN_TIP_LOG_MAGIC;
+        _log->head = _history->processed;
+        _log->headCheck = ~_history->processed;
+    }
+}
+
+uint32_t RainEngine::tipAt(uint32_t index) {
+    return _log->tips[index & (RAIN_TIP_LOG_SIZE - 1)];
+}
+
+// Folds the tips logged since the last call into the totals and drops the
+// ones that fell out of their windows. Amortized O(1) per tip.
+void RainEngine::update(uint32_t now) {
+    uint32_t head = _log->head;
+
+    // tips the interrupt overwrote before we got to them are gone, the
+    // rolling windows restart after them
+    if (head - _history->processed > RAIN_TIP_LOG_SIZE) {
+        uint32_t skipped = head - RAIN_TIP_LOG_SIZE - _history->processed;
+        _history->lost += skipped;
+        _history->processed += skipped;
+        _history->intensityTail = _history->processed;
+        _history->hourTail = _history->processed;
+    }
+
+    while (_history->processed != head) {
+        uint32_t tip = tipAt(_history->processed);
+        _history->processed++;
+
+        // the log isn't covered by a CRC, a tip stamped after now or before
+        // the 24 hour total can't be right and isn't counted
+        if (tip > now || now - tip >= RAIN_DAY_BUCKETS * RAIN_HOUR) {
+            _history->lost++;
+            continue;
+        }
+        expire(tip);
+
+        advanceDay(tip / RAIN_HOUR);
+        _history->dayBuckets[(tip / RAIN_HOUR) % RAIN_DAY_BUCKETS]++;
+        _history->dayCount++;
+
+        uint32_t intensityCount = _history->processed - _history->intensityTail;
+        if (intensityCount > _history->peakIntensityCount) {
+            _history->peakIntensityCount = intensityCount;
+        }
+    }
+
+    expire(now);
+    advanceDay(now / RAIN_HOUR);
+}
+
+// Moves the tips not folded in yet that were stamped up to until on by
+// offset seconds, for tips logged before the clock was set. Call with the
+// interrupt held off.
+void RainEngine::shiftTips(uint32_t until, uint32_t offset) {
+    uint32_t head = _log->head;
+    uint32_t tip = head - _history->processed > RAIN_TIP_LOG_SIZE ? head - RAIN_TIP_LOG_SIZE : _history->processed;
+    for (; tip != head; tip++) {
+        uint32_t* stamp = &_log->tips[tip & (RAIN_TIP_LOG_SIZE - 1)];
+        if (*stamp <= until) {
+            *stamp += offset;
+        }
+    }
+}
+
+void RainEngine::expire(uint32_t now) {
+    expireWindow(&_history->intensityTail, now, RAIN_INTENSITY_WINDOW);
+    expireWindow(&_history->hourTail, now, RAIN_HOUR);
+}
+
+// Moves a window's tail past the tips that are too old at time now.
+void RainEngine::expireWindow(uint32_t* tail, uint32_t now, uint32_t window) {
+    uint32_t processed = _history->processed;
+
+    // only the newest RAIN_TIP_LOG_SIZE tips can be read back, a window
+    // holding more than that is capped
+    if (processed - *tail > RAIN_TIP_LOG_SIZE) {
+        *tail = processed - RAIN_TIP_LOG_SIZE;
+    }
+
+    while (*tail != processed && now - tipAt(*tail) >= window) {
+        (*tail)++;
+    }
+}
+
+// Rolls the 24 hour buckets forward to hour, emptying the ones it passes.
+void RainEngine::advanceDay(uint32_t hour) {
+    if (_history->dayHour == 0 || hour - _history->dayHour >= RAIN_DAY_BUCKETS) {
+        if (_history->dayHour != hour) {
+            memset(_history->dayBuckets, 0, sizeof(_history->dayBuckets));
+            _history->dayCount = 0;
+        }
+        _history->dayHour = hour;
+        return;
+    }
+
+    while (_history->dayHour < hour) {
+        _history->dayHour++;
+        uint16_t* bucket = &_history->dayBuckets[_history->dayHour % RAIN_DAY_BUCKETS];
+        _history->dayCount -= *bucket;
+        *bucket = 0;
+    }
+}
+
+float RainEngine::getHourInches() {
+    return (_history->processed - _history->hourTail) * RAIN_INCHES_PER_TIP;
+}
+
+float RainEngine::getDayInches() {
+    return _history->dayCount * RAIN_INCHES_PER_TIP;
+}
+
+float RainEngine::getIntensity() {
+    return (_history->processed - _history->intensityTail) * RAIN_INCHES_PER_TIP * RAIN_HOUR / RAIN_INTENSITY_WINDOW;
+}
+
+float RainEngine::getPeakIntensity() {
+    return _history->peakIntensityCount * RAIN_INCHES_PER_TIP * RAIN_HOUR / RAIN_INTENSITY_WINDOW;
+}
+
+uint32_t RainEngine::getLostTips() {
+    return _history->lost;
+}
+
+// Tips not yet covered by a successful publish.
+uint32_t RainEngine::getUnreportedTips() {
+    return _history->processed - _history->reported;
+}
+
+// Call once a report made it out. Starts a new report period, which also
+// resets the peak intensity. Until then the tips stay unreported and are
+// sent again with the next report.
+void RainEngine::markReported() {
+    _history->reported = _history->processed;
+    _history->peakIntensityCount = _history->processed - _history->intensityTail;
+}
@@ -0,0 +1,87 @@
+#include <stdint.h>
+
+#ifndef RainEngine_h
+#define RainEngine_h
+
+#define RAIN_INCHES_PER_TIP 0.011
+
+#define RAIN_TIP_LOG_SIZE 256 // power of two, 2.8 inches of rain
+#define RAIN_TIP_LOG_MAGIC 0x52546970 // "RTip", bump when the layout changes
+#define RAIN_HISTORY_MAGIC 0x52616932 // "Rai2", bump when the layout changes
+
+#define RAIN_INTENSITY_WINDOW 300 // seconds, intensity is the rate over the last 5 minutes
+#define RAIN_HOUR 3600
+#define RAIN_DAY_BUCKETS 24 // the 24 hour total is kept per clock hour
+
+// Rain gauge tips as the interrupt logs them, meant to live in retained
+// memory so tips survive sleep and reset. The interrupt only appends to
+// tips[] and bumps head, so the log stays out of any CRC sealed block and
+// carries its own check instead: headCheck is always ~head.
+struct RainTipLog {
+    uint32_t magic;
+    uint32_t tips[RAIN_TIP_LOG_SIZE]; // unix time of each tip, oldest overwritten
+    volatile uint32_t head; // tips ever logged
+    volatile uint32_t headCheck;
+};
+
+// What RainEngine has made of the tip log, meant to live in retained memory
+// next to it so the totals survive a failed publish, sleep and reset. Only
+// updated from the main loop.
+struct RainHistory {
+    uint32_t magic;
+
+    uint32_t processed; // tips folded into the totals
+    uint32_t reported; // tips already published
+    uint32_t lost; // tips overwritten before they were processed, or corrupt
+
+    // oldest tip still inside the last 5 minutes and the last hour, every
+    // processed tip from the tail on is inside the window
+    uint32_t intensityTail;
+    uint32_t hourTail;
+
+    // tips per clock hour for the 24 hour total
+    uint32_t dayHour; // hour (unix time / 3600) of the newest bucket
+    uint16_t dayBuckets[RAIN_DAY_BUCKETS];
+    uint32_t dayCount;
+
+    uint32_t peakIntensityCount; // most tips seen within 5 minutes since the last report
+};
+
+// Keeps rolling 1 hour and 24 hour rain totals and the peak 5 minute rain
+// intensity from the tip log. Every tip is folded in once as it arrives, and
+// expired tips are dropped by moving a tail forward, so no history is ever
+// rescanned.
+// This file only depends on the C library so it also builds on a host.
+class RainEngine {
+    public:
+        RainEngine();
+
+        void init(RainHistory* history, RainTipLog* log);
+        static inline void logTip(RainTipLog* log, uint32_t timestamp) {
+            uint32_t head = log->head;
+            log->tips[head & (RAIN_TIP_LOG_SIZE - 1)] = timestamp;
+            log->head = head + 1;
+            log->headCheck = ~(head + 1);
+        }
+
+        void update(uint32_t now);
+        void shiftTips(uint32_t until, uint32_t offset);
+
+        float getHourInches();
+        float getDayInches();
+        float getIntensity(); // inches per hour over the last 5 minutes
+        float getPeakIntensity(); // inches per hour, highest since the last report
+        uint32_t getLostTips();
+        uint32_t getUnreportedTips();
+        void markReported();
+    private:
+        RainHistory* _history;
+        RainTipLog* _log;
+
+        uint32_t tipAt(uint32_t index);
+        void expire(uint32_t now);
+        void expireWindow(uint32_t* tail, uint32_t now, uint32_t window);
+        void advanceDay(uint32_t hour);
+};
+
+#endif
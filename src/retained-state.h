@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rain-engine.h"
+#include "power-governor.h"
+
+#ifndef RetainedState_h
+#define RetainedState_h
+
+#define RETAINED_STATE_MAGIC 0x464d5253 // "FMRS"
+#define RETAINED_STATE_VERSION 5 // bump when the meaning of a field changes
+
+// a block saved longer ago than this is too old to carry over (seconds)
+#define RETAINED_STATE_MAX_AGE (2*24*60*60)
+
+// Counters and timestamps that have to outlive sleep, a reset or a failed
+// publish. The block lives in retained memory and is sealed with a CRC-32
+// after the main loop changes it, so a reset in the middle of an update, a
+// brown-out or an older firmware's layout is caught instead of published.
+// Only the main loop writes to it, the rain tips the interrupt logs are kept
+// in a RainTipLog of their own.
+struct RetainedState {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size; // sizeof(RetainedState), catches layout changes
+
+    uint32_t savedAt; // Time.now() of the last seal
+    uint32_t nextCycleAt; // Time.now() of the next full acquisition cycle
+    uint32_t lastPublishAt; // Time.now() of the last successful publish
+    uint32_t uploadedSequence; // newest telemetry record the cloud has
+    uint32_t lastReadingAt; // Time.now() of the last reading with a temperature
+    float lastTempF; // for the temperature slope
+    uint32_t restores; // warm starts that picked the block back up
+
+    uint32_t anemometerPulses; // since the block was created
+    uint32_t anemometerDropped;
+
+    PowerState power;
+    RainHistory rain;
+
+    uint32_t crc; // CRC-32 of everything above, keep last
+};
+
+enum RetainedStateStatus {
+    RETAINED_STATE_RESTORED = 0,
+    RETAINED_STATE_COLD, // no block, first power up
+    RETAINED_STATE_CORRUPT, // CRC mismatch
+    RETAINED_STATE_OUTDATED, // written by a different version or layout
+    RETAINED_STATE_STALE // saved too long ago, or in the future
+};
+
+// Validates, clears and seals a RetainedState block.
+// This file only depends on the C library so it also builds on a host.
+class RetainedStateStore {
+    public:
+        // Checks the block left over from before the reset. A block that
+        // doesn't check out is cleared and sealed empty. timeValid tells
+        // whether now can be trusted for the age check.
+        static RetainedStateStatus restore(RetainedState* state, uint32_t now, bool timeValid);
+        static void clear(RetainedState* state, uint32_t now);
+        static void seal(RetainedState* state, uint32_t now);
+        static uint32_t crc32(const uint8_t* data, size_t length);
+};
+
+#endif
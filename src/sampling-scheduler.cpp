@@ -0,0 +1,131 @@
+#include "sampling-scheduler.h"
+
+// ctor()
+SamplingScheduler::SamplingScheduler() {
+    reset();
+}
+
+void SamplingScheduler::reset() {
+    _taskCount = 0;
+    _startedAt = 0;
+    _finishedAt = 0;
+    _rescheduled = false;
+}
+
+// Registers a task. The first step runs startDelay ms after run() is called,
+// then every interval ms until the step reports it is done. Returns the task
+// index, or -1 if the task table is full.
+int SamplingScheduler::addTask(const char* name, SamplingTaskStep step, void* context, unsigned long startDelay, unsigned long interval) {
+    if (_taskCount >= SCHEDULER_MAX_TASKS) {
+        return -1;
+    }
+
+    Task& task = _tasks[_taskCount];
+    task.name = name;
+    task.step = step;
+    task.context = context;
+    task.startDelay = startDelay;
+    task.interval = interval;
+    task.nextRun = 0;
+    task.firstRun = 0;
+    task.finishedAt = 0;
+    task.busyMicros = 0;
+    task.started = false;
+    task.done = false;
+
+    return _taskCount++;
+}
+
+void SamplingScheduler::run() {
+    _startedAt = millis();
+    for (int i = 0; i < _taskCount; i++) {
+        _tasks[i].nextRun = _startedAt + _tasks[i].startDelay;
+    }
+
+    while (true) {
+        bool pending = false;
+        unsigned long nextDue = 0;
+
+        for (int i = 0; i < _taskCount; i++) {
+            Task& task = _tasks[i];
+            if (task.done) {
+                continue;
+            }
+
+            unsigned long now = millis();
+            // signed difference keeps the comparison correct across millis() rollover
+            if ((long)(now - task.nextRun) >= 0) {
+                if (!task.started) {
+                    task.firstRun = now;
+                    task.started = true;
+                }
+
+                _rescheduled = false;
+                unsigned long stepStart = micros();
+                task.done = task.step(task.context);
+                task.busyMicros += micros() - stepStart;
+
+                if (task.done) {
+                    task.finishedAt = millis();
+                    continue;
+                }
+                if (_rescheduled) {
+                    task.nextRun = _rescheduledAt;
+                } else {
+                    task.nextRun += task.interval;
+
+                    // if another task held us up, don't let the missed steps bunch up
+                    unsigned long after = millis();
+                    if ((long)(after - task.nextRun) >= 0) {
+                        task.nextRun = after + task.interval;
+                    }
+                }
+            }
+
+            if (!pending || (long)(task.nextRun - nextDue) < 0) {
+                nextDue = task.nextRun;
+            }
+            pending = true;
+        }
+
+        if (!pending) {
+            break;
+        }
+
+        // nothing is due yet, so sleep until the earliest task needs to run
+        long wait = (long)(nextDue - millis());
+        if (wait > 0) {
+            delay(wait);
+        }
+    }
+
+    _finishedAt = millis();
+}
+
+void SamplingScheduler::runAgainIn(unsigned long delay) {
+    _rescheduled = true;
+    _rescheduledAt = millis() + delay;
+}
+
+int SamplingScheduler::getTaskCount() {
+    return _taskCount;
+}
+
+const char* SamplingScheduler::getTaskName(int task) {
+    return _tasks[task].name;
+}
+
+// Wall-clock time in ms from a task's first step until it finished.
+unsigned long SamplingScheduler::getTaskDuration(int task) {
+    return _tasks[task].finishedAt - _tasks[task].firstRun;
+}
+
+// Time in us actually spent inside the task's steps.
+unsigned long SamplingScheduler::getTaskBusyMicros(int task) {
+    return _tasks[task].busyMicros;
+}
+
+// Wall-clock time in ms of the last run() call.
+unsigned long SamplingScheduler::getElapsed() {
+    return _finishedAt - _startedAt;
+}
@@ -0,0 +1,55 @@
+#include "application.h"
+
+#ifndef SamplingScheduler_h
+#define SamplingScheduler_h
+
+#define SCHEDULER_MAX_TASKS 8
+
+// A task step is called each time the task comes due. It returns true once
+// the task has finished its work and should not be called again.
+typedef bool (*SamplingTaskStep)(void* context);
+
+// Cooperative scheduler used to run the sensor sampling windows side by side.
+// Instead of waiting out each window one after the other, every window is
+// registered as a task and the scheduler interleaves them, so a cycle only
+// stays awake as long as its longest window.
+class SamplingScheduler {
+    public:
+        SamplingScheduler();
+
+        void reset();
+        int addTask(const char* name, SamplingTaskStep step, void* context, unsigned long startDelay, unsigned long interval);
+        void run();
+        // Called from a step that isn't done yet, runs the task again after
+        // delay ms instead of its interval, e.g. once a conversion is due.
+        void runAgainIn(unsigned long delay);
+
+        int getTaskCount();
+        const char* getTaskName(int task);
+        unsigned long getTaskDuration(int task);
+        unsigned long getTaskBusyMicros(int task);
+        unsigned long getElapsed();
+    private:
+        struct Task {
+            const char* name;
+            SamplingTaskStep step;
+            void* context;
+            unsigned long startDelay;
+            unsigned long interval;
+            unsigned long nextRun;
+            unsigned long firstRun;
+            unsigned long finishedAt;
+            unsigned long busyMicros;
+            bool started;
+            bool done;
+        };
+
+        Task _tasks[SCHEDULER_MAX_TASKS];
+        int _taskCount;
+        unsigned long _startedAt;
+        unsigned long _finishedAt;
+        bool _rescheduled;
+        unsigned long _rescheduledAt;
+};
+
+#endif
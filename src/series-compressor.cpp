@@ -0,0 +1,91 @@
+#include "series-compressor.h"
+
+#include <string.h>
+
+static uint32_t zigZag(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static int32_t unZigZag(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static void writeChange(BitWriter& out, int32_t change) {
+    uint32_t z = zigZag(change);
+    if (z == 0) {
+        out.write(0, 1);
+    } else if (z <= 16) {
+        out.write(0x2, 2);
+        out.write(z - 1, 4);
+    } else if (z <= 272) {
+        out.write(0x6, 3);
+        out.write(z - 17, 8);
+    } else {
+        out.write(0x7, 3);
+        out.write(z, 32);
+    }
+}
+
+static int32_t readChange(BitReader& in) {
+    if (!in.read(1)) {
+        return 0;
+    }
+    if (!in.read(1)) {
+        return unZigZag(in.read(4) + 1);
+    }
+    if (!in.read(1)) {
+        return unZigZag(in.read(8) + 17);
+    }
+    return unZigZag(in.read(32));
+}
+
+// ctor()
+SeriesEncoder::SeriesEncoder(int channels) {
+    _channels = channels > SERIES_CHANNELS_MAX ? SERIES_CHANNELS_MAX : channels;
+    _started = false;
+    _timestamp = 0;
+    _interval = 0;
+    memset(_values, 0, sizeof(_values));
+}
+
+void SeriesEncoder::write(BitWriter& out, uint32_t timestamp, const int32_t* values) {
+    if (!_started) {
+        out.write(timestamp, 32);
+        _started = true;
+    } else {
+        int32_t interval = (int32_t)(timestamp - _timestamp);
+        writeChange(out, (int32_t)((uint32_t)interval - (uint32_t)_interval));
+        _interval = interval;
+    }
+    _timestamp = timestamp;
+
+    for (int c = 0; c < _channels; c++) {
+        writeChange(out, (int32_t)((uint32_t)values[c] - (uint32_t)_values[c]));
+        _values[c] = values[c];
+    }
+}
+
+// ctor()
+SeriesDecoder::SeriesDecoder(int channels) {
+    _channels = channels > SERIES_CHANNELS_MAX ? SERIES_CHANNELS_MAX : channels;
+    _started = false;
+    _timestamp = 0;
+    _interval = 0;
+    memset(_values, 0, sizeof(_values));
+}
+
+void SeriesDecoder::read(BitReader& in, uint32_t* timestamp, int32_t* values) {
+    if (!_started) {
+        _timestamp = in.read(32);
+        _started = true;
+    } else {
+        _interval = (int32_t)((uint32_t)_interval + (uint32_t)readChange(in));
+        _timestamp += _interval;
+    }
+    *timestamp = _timestamp;
+
+    for (int c = 0; c < _channels; c++) {
+        _values[c] = (int32_t)((uint32_t)_values[c] + (uint32_t)readChange(in));
+        values[c] = _values[c];
+    }
+}
@@ -0,0 +1,50 @@
+#include <stdint.h>
+
+#include "bit-stream.h"
+
+#ifndef SeriesCompressor_h
+#define SeriesCompressor_h
+
+#define SERIES_CHANNELS_MAX 24
+
+// Gorilla style compression of a timestamped series of integer readings.
+// Timestamps are stored as the change in the time between readings (delta
+// of delta) and every channel as the change from its previous value, zig-zag
+// folded so small changes either way give small codes. Each change then
+// takes the shortest of:
+//   0                  no change
+//   10   + 4 bits      1..16
+//   110  + 8 bits      17..272
+//   111  + 32 bits     anything else
+// A reading whose values didn't move costs one bit per channel. The first
+// reading is coded against zero, so the decoder needs nothing but the
+// stream. State is one value per channel, whatever the batch size.
+// This file only depends on the C library so it also builds on a host.
+class SeriesEncoder {
+    public:
+        SeriesEncoder(int channels);
+
+        void write(BitWriter& out, uint32_t timestamp, const int32_t* values);
+    private:
+        int _channels;
+        bool _started;
+        uint32_t _timestamp;
+        int32_t _interval;
+        int32_t _values[SERIES_CHANNELS_MAX];
+};
+
+// Reads back what SeriesEncoder wrote, exactly.
+class SeriesDecoder {
+    public:
+        SeriesDecoder(int channels);
+
+        void read(BitReader& in, uint32_t* timestamp, int32_t* values);
+    private:
+        int _channels;
+        bool _started;
+        uint32_t _timestamp;
+        int32_t _interval;
+        int32_t _values[SERIES_CHANNELS_MAX];
+};
+
+#endif
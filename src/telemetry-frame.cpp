@@ -0,0 +1,345 @@
+#include "telemetry-frame.h"
+#include "bit-stream.h"
+#include "series-compressor.h"
+
+#include <string.h>
+
+// largest binary frame, fills a 622 byte event once Base64 encoded
+#define FRAME_BYTES_MAX 465
+
+#define TEMP_OFFSET 400 // tenths of degF, so -40.0 degF is 0
+#define TEMP_BITS 11
+#define PROBE_MISSING 2047
+#define PRESSURE_OFFSET 2500 // hundredths of inHg
+#define VCELL_OFFSET 2500 // mV
+
+#define FRAME_CHANNELS_V2 20
+#define FRAME_CHANNELS_V3 22
+#define FRAME_CHANNELS 24
+
+static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// rounds half away from zero, like lround()
+static long divRound(long value, long divisor) {
+    return value >= 0 ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor);
+}
+
+#ifdef TELEMETRY_FRAME_OLD_ENCODERS
+static uint32_t clamp(long value, long low, long high) {
+    return value < low ? low : (value > high ? high : value);
+}
+
+static void writeReading(BitWriter& out, const TelemetryRecord& record, const TelemetryRecord* previous) {
+    if (previous) {
+        out.write(record.timestamp - previous->timestamp, 16);
+    }
+
+    bool hasTempHumidity = record.humidity != TELEMETRY_MISSING_U16 && record.tempF != TELEMETRY_MISSING_I16;
+    bool hasPressure = record.pressure != TELEMETRY_MISSING_U16;
+    bool hasTendency = record.pressureTendency != TELEMETRY_MISSING_I16;
+    out.write(hasTempHumidity, 1);
+    out.write(hasPressure, 1);
+    out.write(hasTendency, 1);
+    if (hasTempHumidity) {
+        out.write(clamp(record.tempF + TEMP_OFFSET, 0, (1 << TEMP_BITS) - 1), TEMP_BITS);
+        out.write(clamp(divRound(record.humidity, 10), 0, 100), 7);
+    }
+    if (hasPressure) {
+        out.write(clamp(divRound(record.pressure, 10) - PRESSURE_OFFSET, 0, 1023), 10);
+    }
+    if (hasTendency) {
+        out.write(clamp(record.pressureTendency, -511, 511) & 0x3FF, 10);
+    }
+
+    out.write(clamp(record.soilTempF + TEMP_OFFSET, 0, (1 << TEMP_BITS) - 1), TEMP_BITS);
+    int probes = record.soilProbeCount > TELEMETRY_SOIL_PROBES ? TELEMETRY_SOIL_PROBES : record.soilProbeCount;
+    out.write(probes, 3);
+    for (int probe = 0; probe < probes; probe++) {
+        int16_t tempF = record.soilProbeTempsF[probe];
+        out.write(tempF == TELEMETRY_MISSING_I16 ? PROBE_MISSING : clamp(tempF + TEMP_OFFSET, 0, PROBE_MISSING - 1), TEMP_BITS);
+    }
+    out.write(clamp(record.soilMoisture, 0, 127), 7);
+
+    out.write(clamp(record.windMPH, 0, 2047), 11);
+    out.write(clamp(record.gustMPH, 0, 2047), 11);
+    out.write(divRound(record.windDegrees, 225) % 16, 4);
+
+    bool hasRain = record.rainTips || record.rainHourTips || record.rainDayTips || record.rainPeakIntensity;
+    out.write(hasRain, 1);
+    if (hasRain) {
+        out.write(clamp(record.rainTips, 0, 1023), 10);
+        out.write(clamp(record.rainHourTips, 0, 1023), 10);
+        out.write(clamp(record.rainDayTips, 0, 4095), 12);
+        out.write(clamp(record.rainPeakIntensity, 0, 2047), 11);
+    }
+
+    out.write(clamp(divRound((long)record.vcell - VCELL_OFFSET, 10), 0, 255), 8);
+    out.write(clamp(record.soc, 0, 127), 7);
+}
+#endif
+
+static void readReading(BitReader& in, TelemetryRecord& record) {
+    bool hasTempHumidity = in.read(1);
+    bool hasPressure = in.read(1);
+    bool hasTendency = in.read(1);
+
+    record.tempF = TELEMETRY_MISSING_I16;
+    record.humidity = TELEMETRY_MISSING_U16;
+    if (hasTempHumidity) {
+        record.tempF = (int)in.read(TEMP_BITS) - TEMP_OFFSET;
+        record.humidity = in.read(7) * 10;
+    }
+    record.pressure = hasPressure ? (in.read(10) + PRESSURE_OFFSET) * 10 : TELEMETRY_MISSING_U16;
+    record.pressureTendency = hasTendency ? in.readSigned(10) : TELEMETRY_MISSING_I16;
+
+    record.soilTempF = (int)in.read(TEMP_BITS) - TEMP_OFFSET;
+    record.soilProbeCount = in.read(3);
+    for (int probe = 0; probe < record.soilProbeCount && probe < TELEMETRY_SOIL_PROBES; probe++) {
+        uint32_t tempF = in.read(TEMP_BITS);
+        record.soilProbeTempsF[probe] = tempF == PROBE_MISSING ? TELEMETRY_MISSING_I16 : (int)tempF - TEMP_OFFSET;
+    }
+    record.soilMoisture = in.read(7);
+
+    record.windMPH = in.read(11);
+    record.gustMPH = in.read(11);
+    record.windDegrees = in.read(4) * 225;
+
+    if (in.read(1)) {
+        record.rainTips = in.read(10);
+        record.rainHourTips = in.read(10);
+        record.rainDayTips = in.read(12);
+        record.rainPeakIntensity = in.read(11);
+    }
+
+    record.vcell = VCELL_OFFSET + in.read(8) * 10;
+    record.soc = in.read(7);
+}
+
+// the version 2 channels of a record, see the header
+static void toChannels(const TelemetryRecord& record, int32_t* channels) {
+    bool hasTempHumidity = record.humidity != TELEMETRY_MISSING_U16 && record.tempF != TELEMETRY_MISSING_I16;
+    channels[0] = hasTempHumidity ? record.tempF : TELEMETRY_MISSING_I16;
+    channels[1] = hasTempHumidity ? divRound(record.humidity, 10) : -1;
+    channels[2] = record.pressure != TELEMETRY_MISSING_U16 ? divRound(record.pressure, 10) : -1;
+    channels[3] = record.pressureTendency;
+    channels[4] = record.soilTempF;
+
+    int probes = record.soilProbeCount > TELEMETRY_SOIL_PROBES ? TELEMETRY_SOIL_PROBES : record.soilProbeCount;
+    channels[5] = probes;
+    for (int probe = 0; probe < TELEMETRY_SOIL_PROBES; probe++) {
+        channels[6 + probe] = probe < probes ? record.soilProbeTempsF[probe] : 0;
+    }
+
+    channels[10] = record.soilMoisture != TELEMETRY_MISSING_U8 ? record.soilMoisture : -1;
+    channels[11] = record.windMPH;
+    channels[12] = record.gustMPH;
+    channels[13] = divRound(record.windDegrees, 225) % 16;
+    channels[14] = record.rainTips;
+    channels[15] = record.rainHourTips;
+    channels[16] = record.rainDayTips;
+    channels[17] = record.rainPeakIntensity;
+    channels[18] = divRound(record.vcell, 10);
+    channels[19] = record.soc;
+    channels[20] = record.interval;
+    channels[21] = record.intervalReason;
+    channels[22] = record.hoursToEmpty != TELEMETRY_MISSING_U16 ? record.hoursToEmpty : -1;
+    channels[23] = record.powerTier;
+}
+
+static void fromChannels(const int32_t* channels, TelemetryRecord& record) {
+    bool hasTempHumidity = channels[1] >= 0;
+    record.tempF = hasTempHumidity ? channels[0] : TELEMETRY_MISSING_I16;
+    record.humidity = hasTempHumidity ? channels[1] * 10 : TELEMETRY_MISSING_U16;
+    record.pressure = channels[2] >= 0 ? channels[2] * 10 : TELEMETRY_MISSING_U16;
+    record.pressureTendency = channels[3];
+    record.soilTempF = channels[4];
+
+    record.soilProbeCount = channels[5];
+    for (int probe = 0; probe < TELEMETRY_SOIL_PROBES; probe++) {
+        record.soilProbeTempsF[probe] = probe < channels[5] ? channels[6 + probe] : 0;
+    }
+
+    record.soilMoisture = channels[10] >= 0 ? channels[10] : TELEMETRY_MISSING_U8;
+    record.windMPH = channels[11];
+    record.gustMPH = channels[12];
+    record.windDegrees = channels[13] * 225;
+    record.rainTips = channels[14];
+    record.rainHourTips = channels[15];
+    record.rainDayTips = channels[16];
+    record.rainPeakIntensity = channels[17];
+    record.vcell = channels[18] * 10;
+    record.soc = channels[19];
+    record.interval = channels[20];
+    record.intervalReason = channels[21];
+    record.hoursToEmpty = channels[22] >= 0 ? channels[22] : TELEMETRY_MISSING_U16;
+    record.powerTier = channels[23];
+}
+
+// how many channels a frame version carries
+static int channelCount(int version) {
+    return version == 2 ? FRAME_CHANNELS_V2 : (version == 3 ? FRAME_CHANNELS_V3 : FRAME_CHANNELS);
+}
+
+static void base64Encode(const uint8_t* data, size_t length, char* out) {
+    size_t o = 0;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t chunk = (uint32_t)data[i] << 16;
+        if (i + 1 < length) chunk |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < length) chunk |= data[i + 2];
+
+        out[o++] = BASE64[(chunk >> 18) & 0x3F];
+        out[o++] = BASE64[(chunk >> 12) & 0x3F];
+        out[o++] = i + 1 < length ? BASE64[(chunk >> 6) & 0x3F] : '=';
+        out[o++] = i + 2 < length ? BASE64[chunk & 0x3F] : '=';
+    }
+    out[o] = 0;
+}
+
+// Returns the number of bytes decoded, or -1 on a character outside the alphabet.
+static int base64Decode(const char* in, uint8_t* out, size_t size) {
+    uint32_t chunk = 0;
+    int bits = 0;
+    size_t length = 0;
+
+    for (; *in && *in != '='; in++) {
+        const char* found = strchr(BASE64, *in);
+        if (!found || !*found) {
+            return -1;
+        }
+        chunk = (chunk << 6) | (found - BASE64);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (length >= size) {
+                return -1;
+            }
+            out[length++] = (chunk >> bits) & 0xFF;
+        }
+    }
+    return length;
+}
+
+// Whether the next record can follow the previous one in the same frame.
+static bool follows(const TelemetryRecord& record, const TelemetryRecord& previous) {
+    return record.sequence == previous.sequence + 1 && record.timestamp - previous.timestamp <= 0xFFFF;
+}
+
+static int packFrame(const TelemetryRecord* records, int count, char* buffer, size_t limit, int version) {
+    uint8_t frame[FRAME_BYTES_MAX];
+    size_t maxBytes = limit > 0 ? (limit - 1) / 4 * 3 : 0;
+    if (maxBytes > sizeof(frame)) {
+        maxBytes = sizeof(frame);
+    }
+
+    BitWriter out(frame, maxBytes);
+    out.write(version, 4);
+    size_t countPosition = out.getBitCount();
+    out.write(0, 6);
+    out.write(count > 0 ? records[0].sequence : 0, 32);
+#ifdef TELEMETRY_FRAME_OLD_ENCODERS
+    if (version == 1) {
+        out.write(count > 0 ? records[0].timestamp : 0, 32);
+    }
+#endif
+
+    SeriesEncoder series(channelCount(version));
+    int32_t channels[FRAME_CHANNELS];
+
+    int packed = 0;
+    while (packed < count && packed < TELEMETRY_FRAME_MAX_READINGS && !out.overflow()) {
+        const TelemetryRecord* previous = packed > 0 ? &records[packed - 1] : 0;
+        if (previous && !follows(records[packed], *previous)) {
+            break;
+        }
+
+        // a reading that doesn't fit is taken back out, encoder state included
+        size_t mark = out.getBitCount();
+        SeriesEncoder seriesMark = series;
+#ifdef TELEMETRY_FRAME_OLD_ENCODERS
+        if (version == 1) {
+            writeReading(out, records[packed], previous);
+        } else
+#endif
+        {
+            toChannels(records[packed], channels);
+            series.write(out, records[packed].timestamp, channels);
+        }
+        if (out.overflow()) {
+            out.truncate(mark);
+            series = seriesMark;
+            break;
+        }
+        packed++;
+    }
+
+    if (packed == 0 || limit == 0) {
+        if (limit > 0) {
+            buffer[0] = 0;
+        }
+        return 0;
+    }
+
+    out.patch(countPosition, packed, 6);
+    base64Encode(frame, out.getByteCount(), buffer);
+    return packed;
+}
+
+int TelemetryFrame::pack(const TelemetryRecord* records, int count, char* buffer, size_t limit) {
+    return packFrame(records, count, buffer, limit, TELEMETRY_FRAME_VERSION);
+}
+
+#ifdef TELEMETRY_FRAME_OLD_ENCODERS
+int TelemetryFrame::pack(const TelemetryRecord* records, int count, char* buffer, size_t limit, int version) {
+    return packFrame(records, count, buffer, limit, version);
+}
+#endif
+
+int TelemetryFrame::decode(const char* frame, TelemetryRecord* records, int max) {
+    uint8_t bytes[FRAME_BYTES_MAX];
+    int length = base64Decode(frame, bytes, sizeof(bytes));
+    if (length < 0) {
+        return -1;
+    }
+
+    BitReader in(bytes, length);
+    int version = in.read(4);
+    if (version < 1 || version > TELEMETRY_FRAME_VERSION) {
+        return -1;
+    }
+    int count = in.read(6);
+    if (count < 1 || count > max) {
+        return -1;
+    }
+
+    uint32_t sequence = in.read(32);
+    uint32_t timestamp = version == 1 ? in.read(32) : 0;
+    // channels an older version doesn't have keep these, the interval is 0
+    // and the time to empty unknown
+    SeriesDecoder series(channelCount(version));
+    int32_t channels[FRAME_CHANNELS] = { 0 };
+    channels[22] = -1;
+
+    for (int i = 0; i < count; i++) {
+        memset(&records[i], 0, sizeof(TelemetryRecord));
+        records[i].sequence = sequence + i;
+        if (version == 1) {
+            if (i > 0) {
+                timestamp += in.read(16);
+            }
+            records[i].timestamp = timestamp;
+            readReading(in, records[i]);
+        } else {
+            series.read(in, &records[i].timestamp, channels);
+            if (channels[5] < 0 || channels[5] > TELEMETRY_SOIL_PROBES) {
+                return -1;
+            }
+            fromChannels(channels, records[i]);
+        }
+    }
+
+    // a frame cut short reads past its end, the padding is under a byte
+    if (in.underflow() || length * 8 - in.getBitCount() >= 8) {
+        return -1;
+    }
+    return count;
+}
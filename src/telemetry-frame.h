@@ -0,0 +1,74 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include "telemetry-record.h"
+
+#ifndef TelemetryFrame_h
+#define TelemetryFrame_h
+
+#define TELEMETRY_FRAME_VERSION 4 // the version pack() writes, bump when a layout changes
+#define TELEMETRY_FRAME_MAX_READINGS 63
+
+// Bit-packed, Base64 encoded telemetry for several consecutive readings.
+// Every field is quantized to what the sensor can actually resolve, so a
+// reading takes about 20 bytes before encoding instead of ~190 as JSON.
+// Version 2 also compresses the series, see below.
+//
+// Version 1 layout, most significant bit first:
+//   version:4 count:6 sequence:32 timestamp:32
+//   then per reading (dt only after the first):
+//     dt:16                     seconds since the previous reading
+//     hasTempHumidity:1 hasPressure:1 hasTendency:1
+//     tempF:11 humidity:7       tenths of degF + 400, whole %
+//     pressure:10               hundredths of inHg - 2500
+//     pressureTendency:10       thousandths of inHg over 3 hours, signed
+//     soilTempF:11 probes:3     tenths of degF + 400, soil profile size
+//     probe:11 x probes         tenths of degF + 400, 2047 if it failed
+//     soilMoisture:7            %
+//     windMPH:11 gustMPH:11     tenths of MPH
+//     windSector:4              22.5 degree vane sector, 0 is north
+//     hasRain:1
+//     rainTips:10 rainHourTips:10 rainDayTips:12 rainPeakIntensity:11
+//     vcell:8 soc:7             10s of mV above 2.5V, whole %
+// Fields behind a flag are only there when the flag is set, and values
+// outside a field's range are clamped to it.
+//
+// Version 2 layout:
+//   version:4 count:6 sequence:32
+//   then the readings as a SeriesEncoder stream with 20 channels: tempF,
+//   humidity, pressure, pressureTendency, soilTempF, probes, probe 0..3,
+//   soilMoisture, windMPH, gustMPH, windSector, rainTips, rainHourTips,
+//   rainDayTips, rainPeakIntensity, vcell (10s of mV) and soc, in the units
+//   of version 1 without the offsets. A missing value is -1, or INT16_MIN
+//   for a signed field, and unused probe slots are 0.
+//
+// Version 3 layout:
+//   as version 2, with two more channels at the end: interval (seconds)
+//   and intervalReason.
+//
+// Version 4 layout:
+//   as version 3, with two more channels at the end: hoursToEmpty (-1 when
+//   unknown) and powerTier. soilMoisture is -1 when the optional sensors
+//   were skipped.
+// This file only depends on the C library so it also builds on a host. The
+// device only writes the current version, the encoders for the older ones
+// are only built with TELEMETRY_FRAME_OLD_ENCODERS defined (host/batch-bench
+// compares them), every version always decodes.
+class TelemetryFrame {
+    public:
+        // Encodes as many of the records as fit in limit bytes (including
+        // the terminating 0) as a Base64 frame. They must have consecutive
+        // sequence numbers. Returns the number of records encoded.
+        static int pack(const TelemetryRecord* records, int count, char* buffer, size_t limit);
+#ifdef TELEMETRY_FRAME_OLD_ENCODERS
+        // As above, in an older layout.
+        static int pack(const TelemetryRecord* records, int count, char* buffer, size_t limit, int version);
+#endif
+
+        // Decodes a frame of either version back into records at the frame's
+        // precision. Returns the number of records, or -1 if the frame is
+        // malformed, of an unknown version or holds more than max records.
+        static int decode(const char* frame, TelemetryRecord* records, int max);
+};
+
+#endif
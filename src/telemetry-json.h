@@ -0,0 +1,71 @@
+// Writes a telemetry record as the single reading JSON payload. The device
+// publishes readings through it (WeatherService::formatRecord()) and the
+// host tools print decoded frames with it, so both say the same thing.
+
+#include "telemetry-record.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+#ifndef TelemetryJson_h
+#define TelemetryJson_h
+
+// appends to buffer, keeping track of the length snprintf would have needed
+#define JSON_APPEND(...) n += snprintf(buffer + (n < (int)size ? n : size), n < (int)size ? size - n : 0, __VA_ARGS__)
+
+// Returns the length of the whole payload, like snprintf, which is more
+// than size when it was cut short.
+static inline int formatRecordJson(const TelemetryRecord& r, char* buffer, size_t size) {
+    int n = 0;
+    JSON_APPEND("{\"n\":%lu,\"ts\":%lu", (unsigned long)r.sequence, (unsigned long)r.timestamp); // record sequence number, unix time of the reading
+    if (r.humidity != TELEMETRY_MISSING_U16) {
+        JSON_APPEND(",\"h\":%.2f,\"t\":%.2f", r.humidity / 10.0, r.tempF / 10.0);
+    }
+    if (r.pressure != TELEMETRY_MISSING_U16) {
+        JSON_APPEND(",\"p\":%.2f", r.pressure / 1000.0);
+    }
+    if (r.pressureTendency != TELEMETRY_MISSING_I16) {
+        JSON_APPEND(",\"pt\":%.3f", r.pressureTendency / 1000.0); // pressure change in inHg over 3 hours
+    }
+    if (r.soilTempF != TELEMETRY_MISSING_I16) {
+        JSON_APPEND(",\"st\":%.2f", r.soilTempF / 10.0); // soil temp in degF
+    }
+    if (r.soilProbeCount > 1) {
+        // soil temp profile, one entry per probe in tenths of degF, null if the probe failed
+        JSON_APPEND(",\"sp\":[");
+        for (int probe = 0; probe < r.soilProbeCount; probe++) {
+            if (r.soilProbeTempsF[probe] == TELEMETRY_MISSING_I16) {
+                JSON_APPEND("%snull", probe ? "," : "");
+            } else {
+                JSON_APPEND("%s%d", probe ? "," : "", r.soilProbeTempsF[probe]);
+            }
+        }
+        JSON_APPEND("]");
+    }
+    if (r.soilMoisture != TELEMETRY_MISSING_U8) {
+        JSON_APPEND(",\"m\":%d", r.soilMoisture); // soil moisture level
+    }
+    // anemometer MPH, 3 second gust MPH, wind vane degrees
+    JSON_APPEND(",\"a\":%.2f,\"g\":%.2f,\"d\":%.2f", r.windMPH / 10.0, r.gustMPH / 10.0, r.windDegrees / 10.0);
+    // rain since the previous record in tenths of inches, over the last hour
+    // and 24 hours in inches, peak 5 minute intensity in inches per hour
+    JSON_APPEND(",\"r\":%.2f,\"r1\":%.2f,\"r24\":%.2f,\"ri\":%.2f", r.rainTips * 0.11, r.rainHourTips * 0.011, r.rainDayTips * 0.011, r.rainPeakIntensity / 100.0);
+    JSON_APPEND(",\"v\":%.2f,\"c\":%d", r.vcell / 1000.0, r.soc); // voltage, state of charge in %
+    if (r.interval) {
+        // seconds until the next reading and why, see IntervalReason. Frames
+        // from before v3 don't carry the interval decision, nor the power tier.
+        JSON_APPEND(",\"iv\":%d,\"ir\":%d", r.interval, r.intervalReason);
+    }
+    if (r.hoursToEmpty != TELEMETRY_MISSING_U16) {
+        JSON_APPEND(",\"te\":%d", r.hoursToEmpty); // predicted hours of battery left
+    }
+    if (r.interval) {
+        JSON_APPEND(",\"pw\":%d", r.powerTier); // power tier, 0 is normal
+    }
+    JSON_APPEND("}");
+    return n;
+}
+
+#undef JSON_APPEND
+
+#endif
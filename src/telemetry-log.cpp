@@ -0,0 +1,87 @@
+#include "telemetry-log.h"
+#include "retained-state.h"
+
+#include <stddef.h>
+
+// ctor()
+TelemetryLog::TelemetryLog() {
+    _startAddress = 0;
+    _slots = 0;
+    _nextSequence = 1;
+}
+
+// Lays the ring over length bytes of EEPROM from startAddress and finds
+// where the last run left off.
+void TelemetryLog::init(int startAddress, int length) {
+    _startAddress = startAddress;
+    _slots = length / sizeof(TelemetryRecord);
+    _nextSequence = 1;
+
+    TelemetryRecord record;
+    for (int slot = 0; slot < _slots; slot++) {
+        EEPROM.get(_startAddress + slot * sizeof(TelemetryRecord), record);
+
+        // erased EEPROM and torn writes fail the CRC, a record in the wrong
+        // slot was written by a log with a different size
+        if (record.crc != recordCrc(record) || record.sequence == 0 || (int)(record.sequence % _slots) != slot) {
+            continue;
+        }
+        if (record.sequence >= _nextSequence) {
+            _nextSequence = record.sequence + 1;
+        }
+    }
+}
+
+// Stores the record under the next sequence number, overwriting the oldest
+// record once the ring is full. Returns the sequence number.
+uint32_t TelemetryLog::append(TelemetryRecord& record) {
+    record.sequence = _nextSequence++;
+    record.reserved = 0;
+    record.crc = recordCrc(record);
+    EEPROM.put(slotAddress(record.sequence), record);
+    return record.sequence;
+}
+
+// Reads a record back. Fails if it was overwritten, never written or
+// doesn't check out.
+bool TelemetryLog::read(uint32_t sequence, TelemetryRecord& record) {
+    if (sequence < getOldestSequence() || sequence >= _nextSequence) {
+        return false;
+    }
+
+    EEPROM.get(slotAddress(sequence), record);
+    return record.sequence == sequence && record.crc == recordCrc(record);
+}
+
+// Writes a record read back with read() over itself once its fields were
+// corrected, under the same sequence number. Fails if it was overwritten
+// since.
+bool TelemetryLog::rewrite(TelemetryRecord& record) {
+    if (record.sequence < getOldestSequence() || record.sequence >= _nextSequence) {
+        return false;
+    }
+
+    record.crc = recordCrc(record);
+    EEPROM.put(slotAddress(record.sequence), record);
+    return true;
+}
+
+uint32_t TelemetryLog::getOldestSequence() {
+    return _nextSequence > (uint32_t)_slots ? _nextSequence - _slots : 1;
+}
+
+uint32_t TelemetryLog::getNextSequence() {
+    return _nextSequence;
+}
+
+int TelemetryLog::getCapacity() {
+    return _slots;
+}
+
+int TelemetryLog::slotAddress(uint32_t sequence) {
+    return _startAddress + (sequence % _slots) * sizeof(TelemetryRecord);
+}
+
+uint32_t TelemetryLog::recordCrc(TelemetryRecord& record) {
+    return RetainedStateStore::crc32((const uint8_t*)&record, offsetof(TelemetryRecord, crc));
+}
@@ -0,0 +1,34 @@
+#include "application.h"
+#include "telemetry-record.h"
+
+#ifndef TelemetryLog_h
+#define TelemetryLog_h
+
+// Append-only ring of TelemetryRecords in emulated EEPROM, so readings are
+// kept while the cellular link is down and can be uploaded in batches.
+// Record n always goes to slot n % slots, so every slot is written once per
+// trip around the ring and no header is rewritten on each append, which
+// spreads the wear evenly. The newest record is found again after a reset
+// by scanning the slots for the highest valid sequence number.
+class TelemetryLog {
+    public:
+        TelemetryLog();
+
+        void init(int startAddress, int length);
+        uint32_t append(TelemetryRecord& record);
+        bool read(uint32_t sequence, TelemetryRecord& record);
+        bool rewrite(TelemetryRecord& record);
+
+        uint32_t getOldestSequence();
+        uint32_t getNextSequence();
+        int getCapacity();
+    private:
+        int _startAddress;
+        int _slots;
+        uint32_t _nextSequence;
+
+        int slotAddress(uint32_t sequence);
+        uint32_t recordCrc(TelemetryRecord& record);
+};
+
+#endif
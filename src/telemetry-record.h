@@ -0,0 +1,44 @@
+#include <stdint.h>
+
+#ifndef TelemetryRecord_h
+#define TelemetryRecord_h
+
+// sentinels for a value the sensor couldn't provide
+#define TELEMETRY_MISSING_I16 INT16_MIN
+#define TELEMETRY_MISSING_U16 0xFFFF
+#define TELEMETRY_MISSING_U8 0xFF
+
+#define TELEMETRY_SOIL_PROBES 4 // soil probe slots per record
+
+// One reading, quantized to the resolution the sensors actually have.
+// Sequence numbers start at 1 and never repeat, so the cloud can put the
+// series back together and drop duplicates.
+struct TelemetryRecord {
+    uint32_t sequence;
+    uint32_t timestamp; // Time.now() of the reading
+    int16_t tempF; // tenths of degF
+    uint16_t humidity; // tenths of %
+    uint16_t pressure; // thousandths of inHg
+    int16_t pressureTendency; // thousandths of inHg over 3 hours
+    int16_t soilTempF; // tenths of degF
+    int16_t soilProbeTempsF[TELEMETRY_SOIL_PROBES]; // tenths of degF
+    uint8_t soilProbeCount;
+    uint8_t soilMoisture; // %, TELEMETRY_MISSING_U8 if skipped
+    uint16_t windMPH; // tenths of MPH
+    uint16_t gustMPH; // tenths of MPH
+    uint16_t windDegrees; // tenths of degrees
+    uint16_t rainTips; // since the previous record
+    uint16_t rainHourTips;
+    uint16_t rainDayTips;
+    uint16_t rainPeakIntensity; // hundredths of inches per hour
+    uint16_t vcell; // mV
+    uint8_t soc; // %
+    uint8_t intervalReason; // IntervalReason behind the interval
+    uint16_t interval; // seconds until the next reading was scheduled
+    uint16_t hoursToEmpty; // predicted battery life
+    uint8_t powerTier; // PowerGovernor tier the reading was taken in
+    uint8_t reserved;
+    uint32_t crc; // CRC-32 of everything above, keep last
+};
+
+#endif
@@ -1,18 +1,68 @@
 #include "weather-service.h"
 
 #include "lib/SparkWeatherShield/SparkFun_Photon_Weather_Shield_Library.h" // Include the SparkFun MPL3115A2 library
-#include "lib/SparkJson/SparkJson.h"
+#include "wind-vane-decoder.h"
+#include "batch-packer.h"
+#include "telemetry-frame.h"
+#include "telemetry-json.h"
 
 #include "OneWire.h"
 
 #include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
 
+// capture the wind vane direction every 200 ms, the power tier sets how many
+// times (10 times over 2 seconds gives a good average)
+#define WIND_VANE_SAMPLE_INTERVAL 200
+
+// how often the anemometer pulses collected by the interrupt are drained
+// during the reading window, the power tier sets the window length
+#define ANEMOMETER_DRAIN_INTERVAL 100
+
+// how long an upload waits for the cloud before giving up until the next cycle
+#define CLOUD_CONNECT_TIMEOUT (60*1000)
+
+// what each tier of battery charge may spend, highest charge first
+static const PowerTier POWER_TIERS[] = {
+    // name       min SoC  min interval  upload every  wind ms  vane samples  optional sensors
+    { "normal",   50,      0,            4,            5000,    10,           true },
+    { "saver",    30,      0,            8,            5000,    10,           true },
+    { "low",      15,      30 * 60,      16,           3000,    5,            false },
+    { "critical", 0,       60 * 60,      24,           3000,    5,            false }
+};
+
+// the barometer logs a pressure sample every 2^5 = 32 seconds
+#define PRESSURE_FIFO_TIME_STEP 5
+
+// how often a one-shot pressure reading is checked on once it's due
+#define PRESSURE_POLL_INTERVAL 2
+
+// counters and timestamps that survive sleep and reset, so rain is kept
+// until a report makes it out
+retained static RetainedState retainedState;
+
+// the rain gauge tips the interrupt logs, outside the sealed block so a tip
+// never leaves it failing its CRC
+retained static RainTipLog rainTipLog;
+
+// ms between publishes when draining the telemetry backlog, and the most
+// records read into one batch (a full event holds about 24 as a frame)
+#define TELEMETRY_PUBLISH_SPACING 1000
+#define TELEMETRY_BATCH_MAX 24
+
+// publish the backlog as bit-packed frames ("wf"), false for JSON batches ("wb")
+#define TELEMETRY_USE_FRAMES true
+
+// DS18B20/DS1822 max conversion time in ms for 9, 10, 11 and 12 bit resolution
+static const unsigned int DS18B20_CONVERSION_MS[] = { 94, 188, 375, 750 };
 
 // ctor()
 WeatherService::WeatherService(){}
 
-void WeatherService::init(bool debugMode) {
+void WeatherService::init(bool debugMode, bool traceMode) {
     _debugMode = debugMode;
+    _traceMode = debugMode && traceMode;
 
     if (debugMode) {
         Serial.begin(9600);   // open serial over USB at 9600 baud
@@ -25,6 +75,21 @@ void WeatherService::init(bool debugMode) {
         while(!Serial.available()) Spark.process();
     }
 
+    // pick up the counters from before the reset, or start over if the
+    // block can't be trusted
+    restoreState();
+
+    _powerGovernor.init(&retainedState.power, POWER_TIERS, sizeof(POWER_TIERS) / sizeof(POWER_TIERS[0]));
+
+    // the telemetry log takes the whole emulated EEPROM
+    _telemetryLog.init(0, EEPROM.length());
+
+    // an upload cursor past the newest record was left behind by a log that
+    // has been erased since, upload the new log from its start
+    if (retainedState.uploadedSequence >= _telemetryLog.getNextSequence()) {
+        retainedState.uploadedSequence = _telemetryLog.getOldestSequence() - 1;
+    }
+
     //Initialize the I2C sensors and ping them
     _sensor.begin();
 
@@ -47,6 +112,11 @@ void WeatherService::init(bool debugMode) {
 
     _sensor.enableEventFlags(); //Necessary register calls to enble temp, baro and alt
 
+    // Let the barometer log pressure on its own into its 32 sample FIFO, one
+    // sample every 2^5 = 32 seconds. Each wake drains it, which gives a ~17
+    // minute pressure series for the tendency without keeping us awake.
+    _sensor.enableFifo(PRESSURE_FIFO_TIME_STEP);
+
     // initialize soil moisture sensor
     //
     // Leaving the soil moisture sensor powered all the time leads to corrosion 
@@ -75,10 +145,8 @@ void WeatherService::init(bool debugMode) {
     // measure the average period (elaspsed time between pulses), and calculate the average windspeed since the last recording.
     _anemometerSignalPin = D3;
     _anemometerScaleMPH = 1.492; // Windspeed if we got a pulse every second (i.e. 1Hz)
-    _lastAnemoneterEvent = 0;
-    _gustPeriod = UINT_MAX;
-    _anemoneterPeriodTotal = 0;
-    _anemoneterPeriodReadingCount = 0;
+    _gustEngine.init(_anemometerScaleMPH);
+    resetAnemometer();
     
     pinMode(_anemometerSignalPin, INPUT_PULLUP);
     attachInterrupt(_anemometerSignalPin, &WeatherService::handleAnemometerEvent, this, FALLING);
@@ -93,68 +161,461 @@ void WeatherService::init(bool debugMode) {
 
     // initialize the rain gauge
     _rainGuageSignalPin = D2;
-    _rainEventCount = 0;
     _lastRainEvent = 0;
+    _clockSet = Time.isValid();
+    _rainEngine.init(&retainedState.rain, &rainTipLog);
+    saveState();
     pinMode(_rainGuageSignalPin, INPUT_PULLUP);
     attachInterrupt(_rainGuageSignalPin, &WeatherService::handleRainEvent, this, FALLING);
 }
 
-char* WeatherService::getWeatherData() {
-    serialPrintln();
+// One pass of loop(): runs the acquisition cycle if it's due and says how
+// long to sleep before the next one. host/cycle-bench and host/trace-replay
+// run the firmware through this too, so they cover the loop that ships.
+LoopPass WeatherService::runOnce() {
+    LoopPass pass = LoopPass();
+
+    // the schedule is kept in retained memory, so a reset doesn't publish
+    // early. Until the clock is set it counts from power up, which schedules
+    // just as well.
+    unsigned long nextCycleAt = getNextCycleAt();
+    long remaining = (long)(nextCycleAt - Time.now());
+    if (nextCycleAt == 0 || remaining <= 0) {
+        unsigned long cycleStart = millis();
+
+        // Only the cloud sets the clock in SEMI_AUTOMATIC mode. Until it has
+        // (after a cold boot, out of coverage), readings and rain tips are
+        // stamped with the time since power up, and moved onto the real time
+        // once an upload connects and the clock is set.
+        _clockSet = Time.isValid();
+        _unsetClockAt = Time.now();
+        _unsetClockMillis = cycleStart;
+
+        // readings are logged every cycle and uploaded together once the power
+        // tier's batch is waiting, so the radio only comes up every few cycles.
+        // When this reading completes a batch, connect in the background while
+        // the sensors are sampled.
+        bool upload = getBacklog() + 1 >= (unsigned long)getUploadEveryCycles();
+        if (upload) {
+            Particle.connect();
+        }
 
-    // Measure Relative Humidity from the HTU21D or Si7021
-    float humidity = _sensor.getRH();
+        // nothing goes out with a stamp from before the clock was set
+        pass.reading = getWeatherData();
+        if (upload && waitFor(Particle.connected, CLOUD_CONNECT_TIMEOUT) && waitFor(Time.isValid, CLOUD_CONNECT_TIMEOUT)) {
+            if (!_clockSet) {
+                catchUpClock();
+            }
+            uploadBacklog();
+        }
 
-    // Measure Temperature from the HTU21D or Si7021
-    float tempf = _sensor.getTempF();
+        // stop mode sleep brings the network back up on every wake, so turn
+        // the radio off or each later cycle and rain wake reconnects the modem
+        if (upload) {
+            Particle.disconnect();
+            Cellular.off();
+        }
 
-    //Measure the Barometer temperature in F from the MPL3115A2
-    // float baroTemp = _sensor.readBaroTempF();
+        remaining = getSleepInterval();
+        setNextCycleAt(Time.now() + remaining);
 
-    //Measure Pressure from the MPL3115A2 in Pascals
-    // 1 Pa = 0.000295299830714 inHg (inches of Mercury)
-    float pascals = _sensor.readPressure();
-    float mmHg = pascals * 0.000295299830714;
+        // the radio was up from the connect until now
+        unsigned long awake = millis() - cycleStart;
+        recordCycle(awake, upload ? awake : 0, remaining);
+
+        pass.cycleRan = true;
+        pass.connected = upload;
+    }
+
+    pass.sleepSeconds = remaining;
+    return pass;
+}
+
+// Called once the cloud has set the clock in a cycle that started without
+// it. Moves the readings not uploaded yet and the rain tips not folded in
+// yet that were stamped from power up onto the real time, by how far the
+// clock stepped since the cycle started.
+void WeatherService::catchUpClock() {
+    uint32_t unsetNow = _unsetClockAt + (millis() - _unsetClockMillis + 500) / 1000;
+    uint32_t offset = Time.now() - unsetNow;
+
+    TelemetryRecord record;
+    int restamped = 0;
+    for (uint32_t sequence = _telemetryLog.getNextSequence() - getBacklog(); sequence < _telemetryLog.getNextSequence(); sequence++) {
+        if (_telemetryLog.read(sequence, record) && record.timestamp <= unsetNow) {
+            record.timestamp += offset;
+            if (_telemetryLog.rewrite(record)) {
+                restamped++;
+            }
+        }
+    }
+
+    // a tip logged during the step would be stamped wrong either way
+    noInterrupts();
+    _rainEngine.shiftTips(unsetNow, offset);
+    interrupts();
+
+    _clockSet = true;
+    saveState();
+
+    serialPrint("Clock set, records restamped: ");
+    serialPrint((long)restamped);
+    serialPrintln();
+}
 
-    //If in altitude mode, you can get a reading in feet with this line:
-    //altf = _sensor.readAltitudeFt();
+// Stop mode sleep for up to the seconds runOnce() asked for. A rain gauge
+// tip wakes us early, so log it and return, loop() goes straight back to
+// sleep for the rest of the interval and only the timer wake runs the full
+// cycle. Returns true when the rain gauge woke us.
+bool WeatherService::sleep(long seconds) {
+    // stop mode sleep picks up right here on wake
+    unsigned long rainTips = getRainTips();
+    System.sleep(_rainGuageSignalPin, FALLING, seconds);
+    if (!System.wokenUpByPin()) {
+        return false;
+    }
+    recordRainWake(rainTips);
+    return true;
+}
 
-    // get fuel guage and bundle with temperature data
+char* WeatherService::getWeatherData() {
+    unsigned long cycleStart = millis();
+    serialPrintln();
+
+    // get fuel guage first, the charge left decides what this cycle may spend
     FuelGauge fuel;
+    _reading.vcell = fuel.getVCell();
+    _reading.soc = fuel.getSoC();
+    trace("c %lu %lu %lu", (unsigned long)Time.now(), cycleStart, (unsigned long)micros());
+    trace("b %.3f %.2f", _reading.vcell, _reading.soc);
+    const PowerTier& tier = _powerGovernor.update(_reading.soc);
+    serialPrint("Power tier: ");
+    serialPrint(tier.name);
+    serialPrintln();
 
-    // get the avg wind speed and gust speed
-    float gustMPH;
-    float windMPH = getAnemometerMPH(&gustMPH);
+    // run every sampling window side by side, so the cycle only stays awake
+    // as long as the longest window instead of the sum of all of them
+    scheduleSampling();
+    _scheduler.run();
+    printSchedulerReport();
 
-    StaticJsonBuffer<400> jsonBuffer;
+    // log the reading, it's uploaded later with the rest of the backlog
+    updateRain();
+    decideSleepInterval();
+    TelemetryRecord record;
+    buildRecord(record);
+    _telemetryLog.append(record);
 
-    JsonObject& root = jsonBuffer.createObject();
-    root["h"] = humidity;
-    root["t"] = tempf;
-    root["p"] = mmHg;
-    root["st"] = getSoilTemp(); // soil temp in degF
-    root["m"] = getSoilMoisture(); // soil moisture level
-    root["a"] = windMPH; // anemometer MPH
-    root["d"] = getWindVaneDegrees(); // wind vane degrees
-    root["r"] = getAndResetRainInches(); // rain gauge count
-    root["v"] = fuel.getVCell(); // voltage
-    root["c"] = fuel.getSoC(); // state of charge in %
+    // the tips are in the log now, the next record starts counting afresh
+    _rainEngine.markReported();
 
     static char buffer[400];
-    root.printTo(buffer, sizeof(buffer));
+    formatRecord(record, buffer, sizeof(buffer));
+
+    serialPrint("Logged record: ");
+    serialPrint((long)record.sequence);
+    serialPrint(", backlog: ");
+    serialPrint((long)getBacklog());
+    serialPrintln();
+
+    saveState();
+
+    serialPrint("Cycle awake time (ms): ");
+    serialPrint((long)(millis() - cycleStart));
+    serialPrintln();
+
     return buffer;
 }
 
-float WeatherService::getSoilTemp() {
-    OneWire ds = OneWire(D4);  // 1-wire signal on pin D4
+void WeatherService::scheduleSampling() {
+    const PowerTier& tier = _powerGovernor.getTier();
+
+    _scheduler.reset();
+    _pressureConverting = false;
+    _windVaneSampleCount = 0;
+    _windVaneSamples = tier.windVaneSamples;
+    _anemometerWindow = tier.anemometerWindow;
+
+    // the optional sensors are left out of the reading when the battery is low
+    unsigned int soilTempConversionMs = 0;
+    if (tier.optionalSensors) {
+        // start the soil temp conversion first, so the wait overlaps everything else
+        soilTempConversionMs = startSoilTempConversion();
+    } else {
+        _reading.soilTempF = NAN;
+        _reading.soilProbeCount = 0;
+        _reading.soilMoisture = -1;
+    }
+
+    // periodic windows first, so their first samples are taken on time
+    _scheduler.addTask("wind vane", &WeatherService::windVaneTask, this, 0, WIND_VANE_SAMPLE_INTERVAL);
+    _scheduler.addTask("anemometer", &WeatherService::anemometerTask, this, 0, ANEMOMETER_DRAIN_INTERVAL);
+
+    // one-shot reads run as soon as the cycle starts
+    _scheduler.addTask("humidity", &WeatherService::humidityTask, this, 0, 0);
+    _scheduler.addTask("pressure", &WeatherService::pressureTask, this, 0, 0);
+    if (tier.optionalSensors) {
+        _scheduler.addTask("soil moisture", &WeatherService::soilMoistureTask, this, 0, 0);
+        _scheduler.addTask("soil temp", &WeatherService::soilTempTask, this, soilTempConversionMs, 0);
+    }
+}
+
+void WeatherService::printSchedulerReport() {
+    serialPrint("Sampling time (ms): ");
+    serialPrint((long)_scheduler.getElapsed());
+    serialPrintln();
+
+    for (int i = 0; i < _scheduler.getTaskCount(); i++) {
+        serialPrint("  ");
+        serialPrint(_scheduler.getTaskName(i));
+        serialPrint(": ");
+        serialPrint((long)_scheduler.getTaskDuration(i));
+        serialPrint(" ms, busy ");
+        serialPrint((long)_scheduler.getTaskBusyMicros(i));
+        serialPrintln(" us");
+    }
+}
+
+bool WeatherService::windVaneTask(void* context) {
+    WeatherService* self = (WeatherService*)context;
+
+    self->captureWindVane();
+    if (++self->_windVaneSampleCount < self->_windVaneSamples) {
+        return false;
+    }
+
+    self->_reading.windDegrees = self->getWindVaneDegrees();
+    return true;
+}
+
+bool WeatherService::anemometerTask(void* context) {
+    WeatherService* self = (WeatherService*)context;
+
+    // the window starts clean, pulses left over from the last cycle are dropped
+    if (self->_anemometerWindowStart == 0) {
+        self->resetAnemometer();
+        self->_anemometerWindowStart = millis();
+        return false;
+    }
+
+    self->drainAnemometerPulses();
+    if (millis() - self->_anemometerWindowStart < self->_anemometerWindow) {
+        return false;
+    }
+
+    // get the avg wind speed and gust speed collected over the window
+    self->_reading.windMPH = self->getAnemometerMPH(&self->_reading.gustMPH);
+    self->_anemometerWindowStart = 0;
+    return true;
+}
+
+bool WeatherService::humidityTask(void* context) {
+    WeatherService* self = (WeatherService*)context;
+
+    // Measure Relative Humidity and Temperature from the HTU21D or Si7021,
+    // the Si7021 gets both from a single conversion
+    // A failed reading is left out of the payload rather than published
+    float humidity, celsius;
+    MeasurementStatus status = self->_sensor.readHumidityAndTemp(&humidity, &celsius);
+    if (status == MEASUREMENT_OK) {
+        self->trace("h %.3f %.3f", humidity, celsius);
+        self->_reading.humidity = humidity;
+        self->_reading.tempF = celsius * 1.8 + 32.0;
+    } else {
+        self->trace(status == MEASUREMENT_BAD_CRC ? "h crc" : "h timeout");
+        self->serialPrintln(status == MEASUREMENT_BAD_CRC ? "Humidity reading failed checksum" : "Humidity reading timed out");
+        self->_reading.humidity = NAN;
+        self->_reading.tempF = NAN;
+    }
+
+    self->printSensorTiming("Humidity", self->_sensor.getHumidityTiming());
+    return true;
+}
+
+bool WeatherService::pressureTask(void* context) {
+    WeatherService* self = (WeatherService*)context;
+
+    // later steps pick up the one-shot reading started below
+    if (self->_pressureConverting) {
+        return self->collectPressure();
+    }
+    self->_pressureTransactions = self->_sensor.getI2CTransactionCount();
+
+    //Drain the pressure series the MPL3115A2 logged while we were asleep
+    PressureSample samples[FIFO_SIZE];
+    byte count = self->_sensor.readFifo(samples, FIFO_SIZE);
+
+    self->_reading.pressureTendency = NAN;
+    // the newest sample was taken up to a time step ago, the rest one time step apart before it
+    for (int i = 0; i < count; i++) {
+        self->trace("p %lu %.2f %.4f", millis() - (count - 1 - i) * (1000UL << PRESSURE_FIFO_TIME_STEP), samples[i].pascals, samples[i].celsius);
+    }
+    if (count > 0) {
+        self->_reading.pressureTendency = self->getPressureTendency(samples, count);
+        self->finishPressure(samples[count - 1].pascals, count);
+        return true;
+    }
+
+    // nothing logged yet (first wake after power up), take a one-shot
+    // reading. The conversion takes up to half a second, so come back when
+    // it's due instead of waiting in the driver, the wind windows keep
+    // sampling meanwhile.
+    self->_sensor.disableFifo();
+    self->_scheduler.runAgainIn(self->_sensor.startPressureAndTemp());
+    self->_pressureConverting = true;
+    return false;
+}
+
+// Picks up the one-shot reading started by pressureTask(), then restarts
+// the FIFO for the next wake.
+bool WeatherService::collectPressure() {
+    float pascals, baroCelsius;
+    MeasurementStatus status = _sensor.pollPressureAndTemp(&pascals, &baroCelsius);
+    if (status == MEASUREMENT_PENDING) {
+        _scheduler.runAgainIn(PRESSURE_POLL_INTERVAL);
+        return false;
+    }
+    _pressureConverting = false;
+
+    if (status != MEASUREMENT_OK) {
+        trace("p timeout");
+        serialPrintln("Pressure reading timed out");
+        pascals = NAN;
+    } else {
+        trace("p %lu %.2f %.4f", millis(), pascals, baroCelsius);
+    }
+    _sensor.enableFifo(PRESSURE_FIFO_TIME_STEP);
+    printSensorTiming("Pressure", _sensor.getBaroTiming());
+
+    finishPressure(pascals, 0);
+    return true;
+}
+
+void WeatherService::finishPressure(float pascals, int count) {
+    // 1 Pa = 0.000295299830714 inHg (inches of Mercury)
+    _reading.pressureInHg = pascals * 0.000295299830714;
+
+    serialPrint("Pressure samples: ");
+    serialPrint((long)count);
+    serialPrint(", I2C transactions: ");
+    serialPrint((long)(_sensor.getI2CTransactionCount() - _pressureTransactions));
+    serialPrintln();
+}
+
+void WeatherService::printSensorTiming(const char* sensor, SensorTiming timing) {
+    if (timing.count == 0) {
+        return;
+    }
+
+    serialPrint(sensor);
+    serialPrint(" conversion (us): ");
+    serialPrint((long)timing.lastMicros);
+    serialPrint(", average ");
+    serialPrint((long)(timing.totalMicros / timing.count));
+    serialPrintln();
+}
+
+// Least squares slope of the FIFO pressure series, as the change in inHg over
+// 3 hours (the usual barometric tendency period). Returns NAN with fewer than
+// two samples.
+float WeatherService::getPressureTendency(PressureSample* samples, int count) {
+    if (count < 2) {
+        return NAN;
+    }
+
+    float meanIndex = (count - 1) / 2.0;
+    float meanPascals = 0;
+    for (int i = 0; i < count; i++) {
+        meanPascals += samples[i].pascals;
+    }
+    meanPascals /= count;
+
+    float covariance = 0;
+    float variance = 0;
+    for (int i = 0; i < count; i++) {
+        float x = i - meanIndex;
+        covariance += x * (samples[i].pascals - meanPascals);
+        variance += x * x;
+    }
+
+    float pascalsPerSample = covariance / variance;
+    float secondsPerSample = (float)(1 << PRESSURE_FIFO_TIME_STEP);
+    float tendency = pascalsPerSample / secondsPerSample * 3.0 * 3600.0 * 0.000295299830714;
+
+    serialPrint("Pressure tendency (inHg/3h): ");
+    serialPrint(tendency, 3);
+    serialPrintln();
+
+    return tendency;
+}
+
+bool WeatherService::soilTempTask(void* context) {
+    WeatherService* self = (WeatherService*)context;
+    self->collectSoilTemp();
+
+    // the shallowest working probe is still reported on its own, missing
+    // when none of them read
+    self->_reading.soilTempF = NAN;
+    for (int probe = self->_reading.soilProbeCount - 1; probe >= 0; probe--) {
+        if (!isnan(self->_reading.soilProbeTempsF[probe])) {
+            self->_reading.soilTempF = self->_reading.soilProbeTempsF[probe];
+        }
+    }
+    return true;
+}
+
+bool WeatherService::soilMoistureTask(void* context) {
+    WeatherService* self = (WeatherService*)context;
+    self->_reading.soilMoisture = self->getSoilMoisture();
+    return true;
+}
+
+// The probes on the 1-Wire bus never change between wakes, so the result of
+// the ROM search is kept in retained memory and reused until a presence or
+// CRC check fails. Every probe keeps the slot it was first found in, so the
+// positions of the depth profile stay put when one drops off the bus.
+retained static SoilProbeTable soilProbeTable;
+
+bool WeatherService::soilProbeTableValid() {
+    if (soilProbeTable.magic != SOIL_PROBE_TABLE_MAGIC || soilProbeTable.count > SOIL_PROBES_MAX) {
+        return false;
+    }
+
+    for (int probe = 0; probe < soilProbeTable.count; probe++) {
+        if (OneWire::crc8(soilProbeTable.addr[probe], 7) != soilProbeTable.addr[probe][7]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Forces a new ROM search at the start of the next conversion, the probes
+// already known keep their slots.
+void WeatherService::invalidateSoilProbeTable() {
+    soilProbeTable.rescan = true;
+}
+
+// The slot of a known probe, -1 for a new one.
+int WeatherService::findSoilProbe(const uint8_t* addr) {
+    for (int probe = 0; probe < soilProbeTable.count; probe++) {
+        if (memcmp(soilProbeTable.addr[probe], addr, 8) == 0) {
+            return probe;
+        }
+    }
+    return -1;
+}
+
+// Enumerates the probes on the 1-Wire bus into the retained device table.
+// Known probes stay in their slots whether they answered or not, new ones
+// take the next free slot.
+void WeatherService::scanSoilProbes(OneWire& ds) {
+    unsigned long scanStart = millis();
 
     byte i;
-    byte present = 0;
-    byte type_s;
-    byte data[12];
     byte addr[8];
-    float celsius, fahrenheit;
+    int found = 0;
 
+    soilProbeTable.rescan = false;
     while (ds.search(addr)) {
 
         // first the returned address is printed
@@ -165,18 +626,19 @@ float WeatherService::getSoilTemp() {
         }
 
         // second the CRC is checked, on fail,
-        // print error and just return to try again
+        // print error and skip the device
         if (OneWire::crc8(addr, 7) != addr[7]) {
             serialPrintln("CRC is not valid!");
-            return 0;
+            continue;
         }
         serialPrintln();
 
         // we have a good address at this point
         // what kind of chip do we have?
-        // we will set a type_s value for known types or just return
+        // we will set a type_s value for known types or skip the device
 
         // the first ROM byte indicates which chip
+        byte type_s;
         switch (addr[0]) {
             case 0x10:
             serialPrintln("  Chip = DS1820/DS18S20");
@@ -196,31 +658,99 @@ float WeatherService::getSoilTemp() {
             break;
             default:
             serialPrintln("Unknown device type.");
-            return 0;
+            continue;
+        }
+
+        found++;
+        if (findSoilProbe(addr) >= 0) {
+            continue;
+        }
+        if (soilProbeTable.count == SOIL_PROBES_MAX) {
+            serialPrintln("  No free soil probe slot");
+            continue;
         }
+        memcpy(soilProbeTable.addr[soilProbeTable.count], addr, 8);
+        soilProbeTable.type[soilProbeTable.count] = type_s;
+        soilProbeTable.count++;
 
-        // this device has temp so let's read it
+        // until its first reading tells us the resolution, assume the 12 bit default
+        soilProbeTable.conversionMs = 750;
+    }
+    ds.reset_search();
 
+    serialPrint("  Soil probes found = ");
+    serialPrint((long)found);
+    serialPrint(" of ");
+    serialPrint((long)soilProbeTable.count);
+    serialPrintln();
+    serialPrint("  Soil probe scan (ms) = ");
+    serialPrint((long)(millis() - scanStart));
+    serialPrintln();
+}
+
+// Starts a temperature conversion on all probes on the 1-Wire bus and
+// returns how long the conversion will take in ms. The result is picked up
+// later by collectSoilTemp(), so the conversion overlaps the other readings.
+unsigned int WeatherService::startSoilTempConversion() {
+    OneWire ds = OneWire(D4);  // 1-wire signal on pin D4
+
+    // start a new table after a cold boot, and search the bus again when a
+    // known probe stopped answering, or nobody answers the reset
+    if (!soilProbeTableValid()) {
+        memset(&soilProbeTable, 0, sizeof(soilProbeTable));
+        soilProbeTable.magic = SOIL_PROBE_TABLE_MAGIC;
+        scanSoilProbes(ds);
+    } else if (soilProbeTable.rescan || !ds.reset()) {
+        scanSoilProbes(ds);
+    }
+
+    // broadcast a single Convert T to every probe at once (Skip ROM), so the
+    // whole profile converts in one conversion time however many probes there are
+    if (soilProbeTable.count > 0) {
         ds.reset();               // first clear the 1-wire bus
-        ds.select(addr);          // now select the device we just found
+        ds.skip();                // address every device on the bus
         // ds.write(0x44, 1);     // tell it to start a conversion, with parasite power on at the end
         ds.write(0x44, 0);        // or start conversion in powered mode (bus finishes low)
+    }
 
-        // just wait a second while the conversion takes place
-        // different chips have different conversion times, check the specs, 1 sec is worse case + 250ms
-        // you could also communicate with other devices if you like but you would need
-        // to already know their address to select them.
+    // different chips have different conversion times, the wait is based on
+    // the resolution decoded from the last reading
+    serialPrint("  Conversion time (ms) = ");
+    serialPrint((long)soilProbeTable.conversionMs);
+    serialPrintln();
 
-        delay(1000);     // maybe 750ms is enough, maybe not, wait 1 sec for conversion
-        
-        // we might do a ds.depower() (parasite) here, but the reset will take care of it.
+    return soilProbeTable.conversionMs;
+}
 
-        // first make sure current values are in the scratch pad
+// Reads the result of the conversion started by startSoilTempConversion()
+// from every probe, in one pass over the device table. Probes that fail to
+// read, or are off the bus, are left as NAN so the depth profile keeps its
+// positions.
+void WeatherService::collectSoilTemp() {
+    OneWire ds = OneWire(D4);  // 1-wire signal on pin D4
 
-        present = ds.reset();
-        ds.select(addr);
-        ds.write(0xB8,0);         // Recall Memory 0
-        ds.write(0x00,0);         // Recall Memory 0
+    byte i;
+    byte present = 0;
+    byte data[12];
+    float celsius = 0;
+    float fahrenheit = 0;
+    unsigned int conversionMs = 0;
+
+    _reading.soilProbeCount = soilProbeTable.count;
+    for (int probe = 0; probe < soilProbeTable.count; probe++) {
+        byte* addr = soilProbeTable.addr[probe];
+        byte type_s = soilProbeTable.type[probe];
+        _reading.soilProbeTempsF[probe] = NAN;
+
+        // we might do a ds.depower() (parasite) here, but the reset will take care of it.
+
+        // the DS2438 keeps its result in page 0, make sure current values are in the scratch pad
+        if (type_s == 2) {
+            present = ds.reset();
+            ds.select(addr);
+            ds.write(0xB8,0);         // Recall Memory 0
+            ds.write(0x00,0);         // Recall Memory 0
+        }
 
         // now read the scratch pad
 
@@ -245,6 +775,16 @@ float WeatherService::getSoilTemp() {
         serialPrint(OneWire::crc8(data, 8), HEX);
         serialPrintln();
 
+        // a missing presence pulse or a bad CRC means the probe didn't answer,
+        // skip this reading and search the bus again on the next wake, so a
+        // probe that dropped off is back in its slot as soon as it returns
+        if (!present || OneWire::crc8(data, 8) != data[8]) {
+            trace("s %02X%02X%02X%02X%02X%02X%02X%02X fail", addr[0], addr[1], addr[2], addr[3], addr[4], addr[5], addr[6], addr[7]);
+            serialPrintln("  Bad soil probe reading, rescanning on next wake");
+            invalidateSoilProbeTable();
+            continue;
+        }
+
         // Convert the data to actual temperature
         // because the result is a 16 bit signed integer, it should
         // be stored to an "int16_t" type, which is always 16 bits
@@ -261,6 +801,7 @@ float WeatherService::getSoilTemp() {
                 raw = (raw & 0xFFF0) + 12 - data[6];
             }
             celsius = (float)raw * 0.0625;
+            conversionMs = max(conversionMs, 750u);
             break;
             case 0:
             // at lower res, the low bits are undefined, so let's zero them
@@ -269,6 +810,7 @@ float WeatherService::getSoilTemp() {
             if (cfg == 0x40) raw = raw & ~1; // 11 bit res, 375 ms
             // default is 12 bit resolution, 750 ms conversion time
             celsius = (float)raw * 0.0625;
+            conversionMs = max(conversionMs, DS18B20_CONVERSION_MS[cfg >> 5]);
             break;
 
             case 2:
@@ -278,21 +820,25 @@ float WeatherService::getSoilTemp() {
             }else{
                 celsius = (float)data[2] + ((float)data[1] * .03125);
             }
+            conversionMs = max(conversionMs, 10u); // temperature only takes 10 ms
         }
 
+        trace("s %02X%02X%02X%02X%02X%02X%02X%02X %.4f", addr[0], addr[1], addr[2], addr[3], addr[4], addr[5], addr[6], addr[7], celsius);
         fahrenheit = celsius * 1.8 + 32.0;
+        _reading.soilProbeTempsF[probe] = fahrenheit;
         serialPrint("  Temperature = ");
         serialPrint(celsius);
         serialPrint(" Celsius, ");
         serialPrint(fahrenheit);
         serialPrintln(" Fahrenheit");
     }
-    ds.reset_search();
 
-    return fahrenheit;
+    if (conversionMs > 0) {
+        soilProbeTable.conversionMs = conversionMs;
+    }
 }
 
-void WeatherService::serialPrint(char s[]) {
+void WeatherService::serialPrint(const char s[]) {
     if (_debugMode) {
         Serial.print(s);
     }
@@ -310,7 +856,7 @@ void WeatherService::serialPrint(long value) {
     }
 }
 
-void WeatherService::serialPrintln(char s[]) {
+void WeatherService::serialPrintln(const char s[]) {
     if (_debugMode) {
         Serial.println(s);
     }
@@ -320,6 +866,21 @@ void WeatherService::serialPrintln() {
     serialPrintln("");
 }
 
+// Trace lines start with @ so a capture of the debug output can be replayed
+// as it is, see host/trace-replay.cpp for what each one holds.
+void WeatherService::trace(const char* format, ...) {
+    if (!_traceMode) {
+        return;
+    }
+
+    char line[64] = "@";
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line + 1, sizeof(line) - 1, format, args);
+    va_end(args);
+    Serial.println(line);
+}
+
 void WeatherService::serialWrite(char c) {
     if (_debugMode) {
         Serial.write(c);
@@ -335,6 +896,7 @@ int WeatherService::getSoilMoisture()
     delay(10); // wait 10 milliseconds 
 
     soilMoistureRaw = analogRead(_soilMoistureSignalPin); // Read the SIG value form sensor 
+    trace("m %d", soilMoistureRaw);
     
     digitalWrite(_soilMoisturePowerPin, LOW); //turn "Off" soil moisture probe
     
@@ -358,71 +920,70 @@ int WeatherService::getSoilMoisture()
 
 void WeatherService::handleAnemometerEvent() {
     // Activated by the magnet in the anemometer (2 ticks per rotation), attached to input D3
-    unsigned int timeAnemometerEvent = millis(); // grab current time
-     
-    //If there's never been an event before (first time through), then just capture it
-    if(_lastAnemoneterEvent != 0) {
-        // Calculate time since last event
-        unsigned int period = timeAnemometerEvent - _lastAnemoneterEvent;
-        // ignore switch-bounce glitches less than 10mS after initial edge (which implies a max windspeed of 149mph)
-        if(period < 10) {
-          return;
-        }
-        if(period < _gustPeriod) {
-            // If the period is the shortest (and therefore fastest windspeed) seen, capture it
-            _gustPeriod = period;
-        }
-        _anemoneterPeriodTotal += period;
-        _anemoneterPeriodReadingCount++;
-    }
-    
-    _lastAnemoneterEvent = timeAnemometerEvent; // set up for next event
+    // Only the timestamp is queued here, the main loop works out the periods.
+    // micros() keeps the 10-20 ms periods of high winds from being quantized.
+    _anemometerPulses.push(micros());
 }
 
-float WeatherService::getAnemometerMPH(float * gustMPH)
-{
-    // force a 5 second anemometer reading
-    bool timerElapsed = false;
-    unsigned long t = millis();
-    while (timerElapsed == false) {
-        if (millis() - t >= 5000) {
-            timerElapsed = true;
-        }    
+// Drops everything collected so far and starts a new reading window.
+void WeatherService::resetAnemometer() {
+    uint32_t timeAnemometerEvent;
+    while (_anemometerPulses.pop(&timeAnemometerEvent)) {
     }
 
-    float result;
-    if(_anemoneterPeriodReadingCount == 0)
-    {
-        *gustMPH = 0.0;
-        result = 0.0;
-    }
-    else {
-        // Nonintuitive math:  We've collected the sum of the observed periods between pulses, and the number of observations.
-        // Now, we calculate the average period (sum / number of readings), take the inverse and muliple by 1000 to give frequency, and then mulitply by our scale to get MPH.
-        // The math below is transformed to maximize accuracy by doing all muliplications BEFORE dividing.
-        result = _anemometerScaleMPH * 1000.0 * float(_anemoneterPeriodReadingCount) / float(_anemoneterPeriodTotal);
-        _anemoneterPeriodTotal = 0;
-        _anemoneterPeriodReadingCount = 0;
-        *gustMPH = _anemometerScaleMPH  * 1000.0 / float(_gustPeriod);
-        _gustPeriod = UINT_MAX;
+    // only overflows inside the window are reported
+    _anemometerOverflows = _anemometerPulses.getOverflowCount();
+
+    _anemometerWindowStart = 0;
+    _gustEngine.reset();
+}
+
+void WeatherService::drainAnemometerPulses() {
+    uint32_t timeAnemometerEvent;
+    while (_anemometerPulses.pop(&timeAnemometerEvent)) {
+        trace("a %lu", (unsigned long)timeAnemometerEvent);
+        _gustEngine.addPulse(timeAnemometerEvent);
     }
+}
+
+float WeatherService::getAnemometerMPH(float * gustMPH)
+{
+    // the reading window itself is timed by the sampling scheduler,
+    // the mean and the 3 second gust come from the pulses it collected
+    _gustEngine.finish(micros());
+    float result = _gustEngine.getMeanMPH();
+    *gustMPH = _gustEngine.getGustMPH();
+    retainedState.anemometerPulses += _gustEngine.getPulseCount();
 
     serialPrint("Anemometer MPH: ");
     serialPrint(result, 2);
+    serialPrint(", gust: ");
+    serialPrint(*gustMPH, 2);
     serialPrintln();
 
+    // pulses the interrupt had to drop because the buffer was full
+    uint32_t overflows = _anemometerPulses.getOverflowCount() - _anemometerOverflows;
+    retainedState.anemometerDropped += overflows;
+    if (overflows > 0) {
+        serialPrint("Anemometer pulses dropped: ");
+        serialPrint((long)overflows);
+        serialPrintln();
+    }
+
     return result;
 }
 
 void WeatherService::captureWindVane() {
     // Read the wind vane, and update the running average of the two components of the vector
     unsigned int windVaneRaw = analogRead(_windVaneSignalPin);
-    
-    float windVaneRadians = lookupRadiansFromRaw(windVaneRaw);
-    if(windVaneRadians > 0 && windVaneRadians < 6.14159)
+    trace("v %u", windVaneRaw);
+
+    // the unit vector of each position is precomputed, no trig per sample
+    int sector = WindVaneDecoder::sectorFromRaw(windVaneRaw);
+    if(sector != WIND_VANE_NO_SECTOR)
     {
-        _windVaneCosTotal += cos(windVaneRadians);
-        _windVaneSinTotal += sin(windVaneRadians);
+        _windVaneCosTotal += WindVaneDecoder::sectorCos(sector);
+        _windVaneSinTotal += WindVaneDecoder::sectorSin(sector);
         _windVaneReadingCount++;
     }
     return;
@@ -430,17 +991,7 @@ void WeatherService::captureWindVane() {
 
 float WeatherService::getWindVaneDegrees()
 {
-    // capturing wind vane direciton 10 times over 2 seconds to get a good average
-    unsigned long t = 0;
-    int windMeasurementCount = 0;
-    while (windMeasurementCount < 10) {
-        if (millis() - t >= 200) {
-            captureWindVane();
-            windMeasurementCount++;
-            t = millis();
-        }    
-    }
-
+    // the samples are captured by the wind vane task of the sampling scheduler
     if(_windVaneReadingCount == 0) {
         return 0;
     }
@@ -462,35 +1013,12 @@ float WeatherService::getWindVaneDegrees()
    return result;
 }
 
-float WeatherService::lookupRadiansFromRaw(unsigned int analogRaw)
-{
-    // The mechanism for reading the weathervane isn't arbitrary, but effectively, we just need to look up which of the 16 positions we're in.
-    if(analogRaw >= 2200 && analogRaw < 2400) return (3.14);//South
-    if(analogRaw >= 2100 && analogRaw < 2200) return (3.53);//SSW
-    if(analogRaw >= 3200 && analogRaw < 3299) return (3.93);//SW
-    if(analogRaw >= 3100 && analogRaw < 3200) return (4.32);//WSW
-    if(analogRaw >= 3890 && analogRaw < 3999) return (4.71);//West
-    if(analogRaw >= 3700 && analogRaw < 3780) return (5.11);//WNW
-    if(analogRaw >= 3780 && analogRaw < 3890) return (5.50);//NW
-    if(analogRaw >= 3400 && analogRaw < 3500) return (5.89);//NNW
-    if(analogRaw >= 3570 && analogRaw < 3700) return (0.00);//North
-    if(analogRaw >= 2600 && analogRaw < 2700) return (0.39);//NNE
-    if(analogRaw >= 2750 && analogRaw < 2850) return (0.79);//NE
-    if(analogRaw >= 1510 && analogRaw < 1580) return (1.18);//ENE
-    if(analogRaw >= 1580 && analogRaw < 1650) return (1.57);//East
-    if(analogRaw >= 1470 && analogRaw < 1510) return (1.96);//ESE
-    if(analogRaw >= 1900 && analogRaw < 2000) return (2.36);//SE
-    if(analogRaw >= 1700 && analogRaw < 1750) return (2.74);//SSE
-    if(analogRaw > 4000) return(-1); // Open circuit?  Probably means the sensor is not connected
-    return -1;
-}
-
 int WeatherService::getRainGaugeSignalPin() {
     return _rainGuageSignalPin;
 }
 
 void WeatherService::handleRainEvent() {
-    // Count rain gauge bucket tips as they occur
+    // Log rain gauge bucket tips as they occur
     // Activated by the magnet and reed switch in the rain gauge, attached to input D2
     unsigned int timeRainEvent = millis(); // grab current time
     
@@ -498,22 +1026,310 @@ void WeatherService::handleRainEvent() {
     if(timeRainEvent - _lastRainEvent < 10) {
       return;
     }
-    
-    _rainEventCount++; //Increase this minute's amount of rain
+
+    // the tip log sits outside the sealed block, nothing to reseal here
+    RainEngine::logTip(&rainTipLog, Time.now()); // timestamp the tip
     _lastRainEvent = timeRainEvent; // set up for next event
 }
 
-float WeatherService::getAndResetRainInches() {
+// Tips logged since power up, used to tell whether a wake tip was caught.
+unsigned long WeatherService::getRainTips() {
+    return rainTipLog.head;
+}
+
+// Called after the rain gauge woke the device from sleep. The edge that
+// wakes the device may not reach the interrupt, so log the tip here if no
+// tip was logged while asleep.
+void WeatherService::recordRainWake(unsigned long tipsBeforeSleep) {
+    noInterrupts();
+    if (rainTipLog.head == tipsBeforeSleep) {
+        handleRainEvent();
+    }
+    interrupts();
+}
+
+void WeatherService::updateRain() {
     const float RAIN_SCALE_IN_TENTHS_OF_INCHES = 0.11;
-    float result = RAIN_SCALE_IN_TENTHS_OF_INCHES * float(_rainEventCount);
+
+    // tips stamped from power up can't be placed in the rolling totals, they
+    // wait in the log until the clock is set
+    if (!_clockSet) {
+        serialPrintln("Clock not set, rain tips held back");
+    }
+
+    // the tips the engine hasn't folded in yet are the ones since the last
+    // cycle, as far as the log still holds them
+    if (_traceMode && _clockSet) {
+        uint32_t head = rainTipLog.head;
+        uint32_t tip = head - retainedState.rain.processed > RAIN_TIP_LOG_SIZE ? head - RAIN_TIP_LOG_SIZE : retainedState.rain.processed;
+        for (; tip != head; tip++) {
+            trace("r %lu", (unsigned long)rainTipLog.tips[tip & (RAIN_TIP_LOG_SIZE - 1)]);
+        }
+    }
+    if (_clockSet) {
+        _rainEngine.update(Time.now());
+    }
+    uint32_t tips = _rainEngine.getUnreportedTips();
+    _reading.rainInches = RAIN_SCALE_IN_TENTHS_OF_INCHES * float(tips);
+    _reading.rainHourInches = _rainEngine.getHourInches();
+    _reading.rainDayInches = _rainEngine.getDayInches();
+    _reading.rainPeakIntensity = _rainEngine.getPeakIntensity();
 
     serialPrint("Rain events: ");
-    serialPrint(_rainEventCount);
+    serialPrint((long)tips);
     serialPrintln();
     serialPrint("Rain (in tenths of inches): ");
-    serialPrint(result, 3);
+    serialPrint(_reading.rainInches, 3);
     serialPrintln();
+    serialPrint("Rain last hour / 24 hours (in): ");
+    serialPrint(_reading.rainHourInches, 3);
+    serialPrint(" / ");
+    serialPrint(_reading.rainDayInches, 3);
+    serialPrintln();
+    serialPrint("Rain peak intensity (in/hr): ");
+    serialPrint(_reading.rainPeakIntensity, 3);
+    serialPrintln();
+    if (_rainEngine.getLostTips() > 0) {
+        serialPrint("Rain tips lost: ");
+        serialPrint((long)_rainEngine.getLostTips());
+        serialPrintln();
+    }
+}
 
-    _rainEventCount = 0;
-    return result;
-}
\ No newline at end of file
+// Sets the bounds in seconds the time between readings adapts within.
+void WeatherService::setSleepBounds(unsigned long minSeconds, unsigned long baseSeconds, unsigned long maxSeconds) {
+    _intervalController.init(minSeconds, baseSeconds, maxSeconds);
+}
+
+// Seconds until the next reading, as decided by the last getWeatherData().
+unsigned long WeatherService::getSleepInterval() {
+    return _intervalController.getInterval();
+}
+
+// Readings logged per connection in the current power tier.
+int WeatherService::getUploadEveryCycles() {
+    return _powerGovernor.getTier().uploadEveryCycles;
+}
+
+// Adds a finished cycle to the energy estimate: awakeMs awake in total,
+// radioMs of them with the radio up, before sleeping sleepSeconds.
+void WeatherService::recordCycle(unsigned long awakeMs, unsigned long radioMs, unsigned long sleepSeconds) {
+    _powerGovernor.recordCycle(awakeMs, radioMs, sleepSeconds);
+    saveState();
+
+    serialPrint("Cycle energy (mAh): ");
+    serialPrint(_powerGovernor.getLastCycleMah(), 3);
+    serialPrint(", average (mA): ");
+    serialPrint(_powerGovernor.getAverageMilliamps(), 2);
+    serialPrint(", hours to empty: ");
+    serialPrint(_powerGovernor.getHoursToEmpty(_reading.soc), 0);
+    serialPrintln();
+}
+
+// Picks the time until the next reading from how fast the weather is
+// changing and how much battery is left.
+void WeatherService::decideSleepInterval() {
+    uint32_t now = Time.now();
+
+    // temperature slope since the previous reading, if it isn't too old to
+    // say, and only once the clock is set
+    float tempSlope = NAN;
+    bool timed = !isnan(_reading.tempF) && Time.isValid();
+    uint32_t elapsed = now - retainedState.lastReadingAt;
+    if (timed && retainedState.lastReadingAt != 0 && elapsed >= 60 && elapsed <= 3 * 60 * 60) {
+        tempSlope = (_reading.tempF - retainedState.lastTempF) * 3600.0 / elapsed;
+    }
+    if (timed) {
+        retainedState.lastReadingAt = now;
+        retainedState.lastTempF = _reading.tempF;
+    }
+
+    IntervalInputs inputs;
+    inputs.pressureTendency = _reading.pressureTendency;
+    inputs.tempSlope = tempSlope;
+    inputs.rainIntensity = _reading.rainPeakIntensity;
+    inputs.soc = _reading.soc;
+    inputs.minInterval = _powerGovernor.getTier().minInterval;
+    _intervalController.decide(inputs);
+
+    serialPrint("Next reading in (s): ");
+    serialPrint((long)_intervalController.getInterval());
+    serialPrint(", ");
+    serialPrint(IntervalController::getReasonName(_intervalController.getReason()));
+    serialPrint(", activity: ");
+    serialPrint(_intervalController.getActivity(), 2);
+    serialPrintln();
+}
+
+// Quantizes the current reading into a telemetry record.
+void WeatherService::buildRecord(TelemetryRecord& record) {
+    memset(&record, 0, sizeof(record));
+    record.timestamp = Time.now();
+
+    if (isnan(_reading.humidity)) {
+        record.tempF = TELEMETRY_MISSING_I16;
+        record.humidity = TELEMETRY_MISSING_U16;
+    } else {
+        // the Si7021 conversion gives a little below 0 and above 100 %RH
+        // near the ends of its range, clamp as the datasheet says so it
+        // can't wrap the unsigned field
+        record.tempF = lround(_reading.tempF * 10.0);
+        record.humidity = lround(min(max(_reading.humidity, 0.0f), 100.0f) * 10.0);
+    }
+    record.pressure = isnan(_reading.pressureInHg) ? TELEMETRY_MISSING_U16 : lround(_reading.pressureInHg * 1000.0);
+    record.pressureTendency = isnan(_reading.pressureTendency) ? TELEMETRY_MISSING_I16 : lround(_reading.pressureTendency * 1000.0);
+
+    record.soilTempF = isnan(_reading.soilTempF) ? TELEMETRY_MISSING_I16 : lround(_reading.soilTempF * 10.0);
+    record.soilProbeCount = min(_reading.soilProbeCount, TELEMETRY_SOIL_PROBES);
+    for (int probe = 0; probe < record.soilProbeCount; probe++) {
+        float tempF = _reading.soilProbeTempsF[probe];
+        record.soilProbeTempsF[probe] = isnan(tempF) ? TELEMETRY_MISSING_I16 : lround(tempF * 10.0);
+    }
+    record.soilMoisture = _reading.soilMoisture < 0 ? TELEMETRY_MISSING_U8 : _reading.soilMoisture;
+
+    record.windMPH = lround(_reading.windMPH * 10.0);
+    record.gustMPH = lround(_reading.gustMPH * 10.0);
+    record.windDegrees = lround(_reading.windDegrees * 10.0);
+
+    record.rainTips = min(_rainEngine.getUnreportedTips(), (uint32_t)TELEMETRY_MISSING_U16 - 1);
+    record.rainHourTips = lround(_reading.rainHourInches / RAIN_INCHES_PER_TIP);
+    record.rainDayTips = lround(_reading.rainDayInches / RAIN_INCHES_PER_TIP);
+    record.rainPeakIntensity = lround(_reading.rainPeakIntensity * 100.0);
+
+    record.vcell = lround(_reading.vcell * 1000.0);
+    record.soc = lround(_reading.soc);
+
+    record.interval = _intervalController.getInterval();
+    record.intervalReason = _intervalController.getReason();
+
+    float hoursToEmpty = _powerGovernor.getHoursToEmpty(_reading.soc);
+    record.hoursToEmpty = isnan(hoursToEmpty) ? TELEMETRY_MISSING_U16 : min(lround(hoursToEmpty), (long)TELEMETRY_MISSING_U16 - 1);
+    record.powerTier = retainedState.power.tier;
+}
+
+// Writes a record out in the same shape the readings have always been
+// published in, plus its sequence number and timestamp.
+void WeatherService::formatRecord(TelemetryRecord& record, char* buffer, size_t size) {
+    // the same payload the host tools print for a decoded frame
+    formatRecordJson(record, buffer, size);
+}
+
+// Records logged but not uploaded yet. A cursor ahead of the log leaves
+// nothing to upload rather than wrapping around.
+unsigned long WeatherService::getBacklog() {
+    uint32_t next = _telemetryLog.getNextSequence();
+    uint32_t first = min(max(retainedState.uploadedSequence + 1, _telemetryLog.getOldestSequence()), next);
+    return next - first;
+}
+
+// Publishes the logged records the cloud doesn't have yet, oldest first,
+// packing as many into each event as fit. A record the batch can't hold
+// goes out on its own as a "w" event. Stops at the first failed publish,
+// the rest go out with the next upload. Returns the number of records
+// published.
+int WeatherService::uploadBacklog() {
+    char payload[BATCH_EVENT_LIMIT];
+    TelemetryRecord batch[TELEMETRY_BATCH_MAX];
+    int published = 0;
+    int publishes = 0;
+    long bytes = 0;
+
+    uint32_t sequence = max(retainedState.uploadedSequence + 1, _telemetryLog.getOldestSequence());
+    while (sequence < _telemetryLog.getNextSequence()) {
+        // a batch holds consecutive records, so it ends at one that doesn't read back
+        int count = 0;
+        while (count < TELEMETRY_BATCH_MAX && sequence + count < _telemetryLog.getNextSequence()
+                && _telemetryLog.read(sequence + count, batch[count])) {
+            count++;
+        }
+
+        // skip a record that doesn't read back instead of retrying it forever,
+        // there's nothing left of it to publish
+        if (count == 0) {
+            serialPrint("Unreadable record skipped: ");
+            serialPrint((long)sequence);
+            serialPrintln();
+            sequence++;
+            retainedState.uploadedSequence = sequence - 1;
+            saveState();
+            continue;
+        }
+
+        const char* event = TELEMETRY_USE_FRAMES ? "wf" : "wb";
+        int packed = TELEMETRY_USE_FRAMES ? TelemetryFrame::pack(batch, count, payload, sizeof(payload))
+            : BatchPacker::pack(batch, count, payload, sizeof(payload));
+        if (packed == 0) {
+            // the first record doesn't fit or encode, send it as the single
+            // reading JSON the readings were first published in
+            formatRecord(batch[0], payload, sizeof(payload));
+            event = "w";
+            packed = 1;
+        }
+
+        // stay under the cloud's limit of one event per second
+        if (publishes > 0) {
+            delay(TELEMETRY_PUBLISH_SPACING);
+        }
+        if (!Particle.publish(event, payload, PRIVATE)) {
+            break;
+        }
+        publishes++;
+        published += packed;
+        bytes += strlen(payload);
+        retainedState.lastPublishAt = Time.now();
+
+        sequence += packed;
+        retainedState.uploadedSequence = sequence - 1;
+        saveState();
+    }
+
+    serialPrint("Uploaded records: ");
+    serialPrint((long)published);
+    serialPrint(" in ");
+    serialPrint((long)publishes);
+    serialPrint(" publishes, backlog: ");
+    serialPrint((long)getBacklog());
+    serialPrintln();
+    if (published > 0) {
+        serialPrint("Payload bytes per reading: ");
+        serialPrint((double)bytes / published, 1);
+        serialPrintln();
+    }
+
+    return published;
+}
+
+unsigned long WeatherService::getNextCycleAt() {
+    return retainedState.nextCycleAt;
+}
+
+void WeatherService::setNextCycleAt(unsigned long time) {
+    retainedState.nextCycleAt = time;
+    saveState();
+}
+
+void WeatherService::restoreState() {
+    static const char* const STATE_STATUS[] = { "restored", "cold start", "corrupt, discarded", "outdated, discarded", "stale, discarded" };
+
+    unsigned long start = micros();
+    RetainedStateStatus status = RetainedStateStore::restore(&retainedState, Time.now(), Time.isValid());
+    unsigned long elapsed = micros() - start;
+
+    serialPrint("Retained state: ");
+    serialPrint(STATE_STATUS[status]);
+    serialPrint(" (us): ");
+    serialPrint((long)elapsed);
+    serialPrintln();
+    if (status == RETAINED_STATE_RESTORED) {
+        serialPrint("Last publish: ");
+        serialPrint((long)retainedState.lastPublishAt);
+        serialPrint(", restores: ");
+        serialPrint((long)retainedState.restores);
+        serialPrintln();
+    }
+}
+
+// Reseals the retained block after the main loop changed it.
+void WeatherService::saveState() {
+    RetainedStateStore::seal(&retainedState, Time.now());
+}
@@ -2,20 +2,137 @@
 
 #include "lib/SparkWeatherShield/SparkFun_Photon_Weather_Shield_Library.h" // Include the SparkFun MPL3115A2 library
 #include "OneWire.h"
+#include "sampling-scheduler.h"
+#include "pulse-ring-buffer.h"
+#include "gust-engine.h"
+#include "rain-engine.h"
+#include "retained-state.h"
+#include "telemetry-log.h"
+#include "interval-controller.h"
+#include "power-governor.h"
 
 #ifndef WeatherService_h
 #define WeatherService_h
 
+// The time between readings adapts to the weather and the battery around
+// MINUTES_TO_SLEEP, within these bounds in seconds. setup() and the host
+// runs hand them to setSleepBounds().
+#define MINUTES_TO_SLEEP (15*60)
+#define MIN_SECONDS_TO_SLEEP (5*60)
+#define MAX_SECONDS_TO_SLEEP (60*60)
+
+// Soil temperature probes form a depth profile, in the order the first ROM
+// search found them. Label the probes by that order when burying them at
+// their depths. A probe keeps its slot while it's off the bus.
+#define SOIL_PROBES_MAX 4
+
+// Anemometer pulses (micros() timestamps) waiting for the main loop, drained
+// every 100 ms. At the 100 Hz debounce limit that's 10 pulses, 64 leaves
+// plenty of headroom.
+#define ANEMOMETER_PULSE_BUFFER_SIZE 64
+#define SOIL_PROBE_TABLE_MAGIC 0x536f5032 // "SoP2", bump when the layout changes
+
+// 1-Wire soil temperature probes found by the ROM searches so far, one slot
+// per probe.
+struct SoilProbeTable {
+    uint32_t magic;
+    uint8_t count;
+    bool rescan; // a known probe didn't answer, search the bus again
+    uint8_t addr[SOIL_PROBES_MAX][8];
+    uint8_t type[SOIL_PROBES_MAX];
+    uint16_t conversionMs;
+};
+
+// Values captured by the sampling tasks during one acquisition cycle.
+struct WeatherReading {
+    float humidity;
+    float tempF;
+    float pressureInHg;
+    float pressureTendency;
+    float soilTempF;
+    float soilProbeTempsF[SOIL_PROBES_MAX];
+    int soilProbeCount;
+    int soilMoisture;
+    float windMPH;
+    float gustMPH;
+    float windDegrees;
+    float rainInches;
+    float rainHourInches;
+    float rainDayInches;
+    float rainPeakIntensity;
+    float vcell;
+    float soc;
+};
+
+// What one pass of loop() did, see WeatherService::runOnce().
+struct LoopPass {
+    bool cycleRan; // the acquisition cycle was due and ran
+    bool connected; // the radio came up to upload the backlog
+    char* reading; // the reading as JSON, when the cycle ran
+    long sleepSeconds; // until the next cycle is due
+};
+
 class WeatherService {
     public:
         WeatherService();
         
-        void init(bool debugMode);
+        // traceMode adds the trace lines host/trace-replay plays back to
+        // the debug output, it needs debugMode
+        void init(bool debugMode, bool traceMode = false);
+        void setSleepBounds(unsigned long minSeconds, unsigned long baseSeconds, unsigned long maxSeconds);
+        LoopPass runOnce();
+        bool sleep(long seconds);
+        unsigned long getSleepInterval();
+        int getUploadEveryCycles();
+        void recordCycle(unsigned long awakeMs, unsigned long radioMs, unsigned long sleepSeconds);
         char* getWeatherData();
+        unsigned long getBacklog();
+        int uploadBacklog();
+        unsigned long getNextCycleAt();
+        void setNextCycleAt(unsigned long time);
         int getRainGaugeSignalPin();
+        unsigned long getRainTips();
     private:
+        void recordRainWake(unsigned long tipsBeforeSleep);
+
+        // whether the clock was set when the cycle started, and where the
+        // unset clock stood then
+        bool _clockSet;
+        uint32_t _unsetClockAt;
+        unsigned long _unsetClockMillis;
+        void catchUpClock();
+
         Weather _sensor;
         bool _debugMode;
+        bool _traceMode;
+
+        SamplingScheduler _scheduler;
+        WeatherReading _reading;
+        PowerGovernor _powerGovernor;
+        IntervalController _intervalController;
+        void decideSleepInterval();
+
+        TelemetryLog _telemetryLog;
+        void buildRecord(TelemetryRecord& record);
+        void formatRecord(TelemetryRecord& record, char* buffer, size_t size);
+
+        void restoreState();
+        void saveState();
+        void scheduleSampling();
+        void printSchedulerReport();
+        static bool windVaneTask(void* context);
+        static bool anemometerTask(void* context);
+        static bool humidityTask(void* context);
+        static bool pressureTask(void* context);
+        static bool soilTempTask(void* context);
+        static bool soilMoistureTask(void* context);
+
+        bool collectPressure();
+        void finishPressure(float pascals, int count);
+        float getPressureTendency(PressureSample* samples, int count);
+        bool _pressureConverting;
+        unsigned long _pressureTransactions;
+        void printSensorTiming(const char* sensor, SensorTiming timing);
         
         int _soilMoistureSignalPin;
         int _soilMoisturePowerPin;
@@ -24,37 +141,48 @@ class WeatherService {
         
         int _anemometerSignalPin;
         float _anemometerScaleMPH;
-        unsigned int _lastAnemoneterEvent;
-        volatile unsigned int _gustPeriod;
-        volatile unsigned int _anemoneterPeriodTotal;
-        volatile unsigned int _anemoneterPeriodReadingCount;
+        PulseRingBuffer<ANEMOMETER_PULSE_BUFFER_SIZE> _anemometerPulses;
+        uint32_t _anemometerOverflows;
+        unsigned long _anemometerWindowStart;
+        unsigned long _anemometerWindow;
+        GustEngine _gustEngine;
 
         int _windVaneSignalPin;
         float _windVaneCosTotal;
         float _windVaneSinTotal;
         unsigned int _windVaneReadingCount;
+        int _windVaneSampleCount;
+        int _windVaneSamples;
+
+        bool soilProbeTableValid();
+        void invalidateSoilProbeTable();
+        int findSoilProbe(const uint8_t* addr);
+        void scanSoilProbes(OneWire& ds);
+        unsigned int startSoilTempConversion();
+        void collectSoilTemp();
 
-        float getSoilTemp();
-        void serialPrint(char s[]);
+        void serialPrint(const char s[]);
         void serialPrint(long value);
         void serialPrint(double value, int digits);
         void serialWrite(char c);
-        void serialPrintln(char s[]);
+        void serialPrintln(const char s[]);
         void serialPrintln();
+        void trace(const char* format, ...);
         int getSoilMoisture();
         
         void handleAnemometerEvent();
+        void resetAnemometer();
+        void drainAnemometerPulses();
         float getAnemometerMPH(float * gustMPH);
 
         void captureWindVane();
-        float lookupRadiansFromRaw(unsigned int analogRaw);
         float getWindVaneDegrees();
 
         int _rainGuageSignalPin;
         void handleRainEvent();
-        volatile unsigned int _rainEventCount;
         unsigned int _lastRainEvent;
-        float getAndResetRainInches();
+        RainEngine _rainEngine;
+        void updateRain();
 };
 
 #endif
\ No newline at end of file
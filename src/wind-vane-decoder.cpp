@@ -0,0 +1,64 @@
+#include "wind-vane-decoder.h"
+
+// ADC ranges of the vane positions, sorted by their lower bound.
+// The upper bound is exclusive, values in the gaps aren't a valid position.
+const uint16_t WindVaneDecoder::RANGE_LOW[WIND_VANE_SECTORS] = {
+    1470, 1510, 1580, 1700, 1900, 2100, 2200, 2600,
+    2750, 3100, 3200, 3400, 3570, 3700, 3780, 3890
+};
+
+const uint16_t WindVaneDecoder::RANGE_HIGH[WIND_VANE_SECTORS] = {
+    1510, 1580, 1650, 1750, 2000, 2200, 2400, 2700,
+    2850, 3200, 3299, 3500, 3700, 3780, 3890, 3999
+};
+
+const int8_t WindVaneDecoder::RANGE_SECTOR[WIND_VANE_SECTORS] = {
+    5,  // ESE
+    3,  // ENE
+    4,  // East
+    7,  // SSE
+    6,  // SE
+    9,  // SSW
+    8,  // South
+    1,  // NNE
+    2,  // NE
+    11, // WSW
+    10, // SW
+    15, // NNW
+    0,  // North
+    13, // WNW
+    14, // NW
+    12  // West
+};
+
+// cos and sin of sector * 22.5 degrees
+const float WindVaneDecoder::SECTOR_COS[WIND_VANE_SECTORS] = {
+    1.0000000f, 0.9238795f, 0.7071068f, 0.3826834f, 0.0000000f, -0.3826834f, -0.7071068f, -0.9238795f,
+    -1.0000000f, -0.9238795f, -0.7071068f, -0.3826834f, 0.0000000f, 0.3826834f, 0.7071068f, 0.9238795f
+};
+
+const float WindVaneDecoder::SECTOR_SIN[WIND_VANE_SECTORS] = {
+    0.0000000f, 0.3826834f, 0.7071068f, 0.9238795f, 1.0000000f, 0.9238795f, 0.7071068f, 0.3826834f,
+    0.0000000f, -0.3826834f, -0.7071068f, -0.9238795f, -1.0000000f, -0.9238795f, -0.7071068f, -0.3826834f
+};
+
+// Returns the sector for an ADC reading, or WIND_VANE_NO_SECTOR if the
+// reading doesn't match a position (open circuit reads above 4000).
+int WindVaneDecoder::sectorFromRaw(unsigned int analogRaw) {
+    if (analogRaw < RANGE_LOW[0]) {
+        return WIND_VANE_NO_SECTOR;
+    }
+
+    // find the last range starting at or below the reading, a fixed 4 step
+    // binary search over the 16 ranges without data dependent branches
+    int i = 0;
+    i += (RANGE_LOW[i + 8] <= analogRaw) << 3;
+    i += (RANGE_LOW[i + 4] <= analogRaw) << 2;
+    i += (RANGE_LOW[i + 2] <= analogRaw) << 1;
+    i += (RANGE_LOW[i + 1] <= analogRaw);
+
+    if (analogRaw >= RANGE_HIGH[i]) {
+        return WIND_VANE_NO_SECTOR;
+    }
+    return RANGE_SECTOR[i];
+}
@@ -0,0 +1,32 @@
+#include <stdint.h>
+
+#ifndef WindVaneDecoder_h
+#define WindVaneDecoder_h
+
+#define WIND_VANE_SECTORS 16
+#define WIND_VANE_NO_SECTOR -1
+
+// Decodes the 12-bit ADC reading of the wind vane into one of its 16
+// positions (sector 0 is North, counting clockwise in 22.5 degree steps).
+//
+// The vane's resistor network doesn't put the sectors in order on the ADC
+// scale, so the ranges are kept sorted by their lower bound and found with
+// a binary search, 4 comparisons per sample. The unit vector of every
+// sector is precomputed, so averaging samples never calls cos() or sin().
+// This file only depends on the C library so it also builds on a host.
+class WindVaneDecoder {
+    public:
+        static int sectorFromRaw(unsigned int analogRaw);
+
+        static inline float sectorCos(int sector) { return SECTOR_COS[sector]; }
+        static inline float sectorSin(int sector) { return SECTOR_SIN[sector]; }
+        static inline float sectorDegrees(int sector) { return sector * 22.5; }
+    private:
+        static const uint16_t RANGE_LOW[WIND_VANE_SECTORS];
+        static const uint16_t RANGE_HIGH[WIND_VANE_SECTORS];
+        static const int8_t RANGE_SECTOR[WIND_VANE_SECTORS];
+        static const float SECTOR_COS[WIND_VANE_SECTORS];
+        static const float SECTOR_SIN[WIND_VANE_SECTORS];
+};
+
+#endif